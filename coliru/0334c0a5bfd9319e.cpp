@@ -0,0 +1,712 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout, cerr
+
+#include <array>  // array
+#include <atomic>  // atomic
+#include <chrono>  // steady_clock
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t, uint16_t, uint32_t, uint64_t, uintptr_t
+#include <cstdlib>  // abort
+#include <limits>  // numeric_limits
+#include <list>  // list
+#include <mutex>  // mutex, lock_guard
+#include <new>  // placement new
+#include <thread>  // thread
+#include <type_traits>  // invoke_result
+#include <utility>  // forward
+#include <vector>  // vector
+
+#include <sys/mman.h>  // mmap, madvise, mlock
+#include <unistd.h>  // sysconf
+
+
+
+[[noreturn]] void fatal(const char* what)
+{
+    std::cerr << "fatal: " << what << std::endl;
+    std::abort();
+}
+
+
+template<class T>
+class pool_of;
+
+
+// Maybe-like result of occupy: Nothing, or an object in the pool. Does not
+// own the object -- it goes back to the pool with pool_of<T>::release only.
+// Operations on Nothing have no effect, dereferencing it is a fatal error.
+template<class T>
+class maybe
+{
+ public:
+    maybe() = default;  // Nothing
+    explicit maybe(T* _p) : p{_p} {}
+
+    explicit operator bool() const noexcept { return p != nullptr; }
+
+    T& operator*() const { if (p == nullptr) fatal("Nothing dereferenced"); return *p; }
+    T* operator->() const { return &**this; }
+
+    T* get() const noexcept { return p; }
+
+    // f : T& -> maybe<U>
+    template<class F>
+    std::invoke_result_t<F, T&> and_then(F&& f) const { return p ? f(*p) : std::invoke_result_t<F, T&>{}; }
+
+    // Links the objects if both are there.
+    template<class U>
+    void link(const maybe<U>& next) const { if (p && next) p->link(next.get()); }
+
+    // Links the objects if both are there, otherwise next goes back to its
+    // pool: nobody would own it once this is Nothing.
+    template<class U>
+    void link_or_release(maybe<U>& next) const
+    {
+        if (p) link(next);
+        else pool_of<U>::release(next);
+    }
+
+ private:
+    T* p = nullptr;
+};
+
+
+struct region_options
+{
+    bool huge_pages = false;  // explicit huge pages if reserved, transparent ones otherwise
+    bool lock = false;  // mlock: never swapped out
+    bool populate = true;  // all the pages faulted in upon init
+};
+
+struct region_status
+{
+    std::size_t bytes = 0;
+    bool huge_pages = false;  // explicit huge pages (MAP_HUGETLB) were used
+    bool locked = false;
+};
+
+// Number of slots in each state; everything is preallocated, nothing is unborn.
+struct occupancy
+{
+    std::size_t free = 0;
+    std::size_t occupied = 0;
+};
+
+
+
+// ------------------------------------
+
+
+// Pool from coliru/3f1f7afeb51db795.cpp.
+//
+// Fixed number of T objects in a single mmap-ed region, mapped once upon
+// system start with init() and never unmapped. Free slots form a lock-free
+// stack of indices with a tagged head (see coliru/d5072567bab16643.cpp);
+// objects are constructed in place on occupy and destroyed on release.
+// Running out of slots gives Nothing, releasing twice or releasing what is
+// not from the pool is a fatal error.
+template<class T>
+class pool_of
+{
+    static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+    static constexpr std::uint64_t pack(std::uint32_t index, std::uint32_t tag) { return (std::uint64_t{tag} << 32) | index; }
+    static constexpr std::uint32_t index_of(std::uint64_t h) { return static_cast<std::uint32_t>(h); }
+    static constexpr std::uint32_t tag_of(std::uint64_t h) { return static_cast<std::uint32_t>(h >> 32); }
+
+    enum : std::uint8_t { is_free, is_occupied };
+
+    struct meta
+    {
+        std::atomic<std::uint32_t> next;
+        std::atomic<std::uint8_t> state;
+    };
+
+    struct storage
+    {
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "tagged head must be lock-free");
+    static_assert(alignof(T) <= 4096, "objects are placed at the start of the region");
+
+ public:
+
+    static region_status init(std::size_t capacity, region_options o = region_options{})
+    {
+        if (slots != nullptr) fatal("pool_of initialised twice");
+        if (capacity == 0 || capacity >= none) fatal("pool_of capacity out of range");
+
+        const std::size_t objects = capacity * sizeof(storage);
+        const std::size_t meta_at = (objects + alignof(meta) - 1) / alignof(meta) * alignof(meta);
+        const std::size_t page = o.huge_pages ? (std::size_t{2} << 20) : static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+        region_status r;
+        r.bytes = (meta_at + capacity * sizeof(meta) + page - 1) / page * page;
+
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS | (o.populate ? MAP_POPULATE : 0);
+        void* base = MAP_FAILED;
+
+        if (o.huge_pages)
+        {
+            base = ::mmap(nullptr, r.bytes, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+            r.huge_pages = (base != MAP_FAILED);
+        }
+
+        if (base == MAP_FAILED)
+        {
+            // not reserved: transparent huge pages if enabled (before the pages are faulted in)
+            base = ::mmap(nullptr, r.bytes, PROT_READ | PROT_WRITE, (flags & ~MAP_POPULATE), -1, 0);
+
+            if (base == MAP_FAILED) fatal("pool_of region cannot be mapped");
+
+            if (o.huge_pages) ::madvise(base, r.bytes, MADV_HUGEPAGE);
+            if (o.populate) for (std::size_t b = 0; b < r.bytes; b += 4096) static_cast<volatile unsigned char*>(base)[b] = 0;
+        }
+
+        r.locked = o.lock && (::mlock(base, r.bytes) == 0);
+
+        slots = static_cast<storage*>(base);
+        metas = reinterpret_cast<meta*>(static_cast<unsigned char*>(base) + meta_at);
+        size = static_cast<std::uint32_t>(capacity);
+
+        for (std::uint32_t i = 0; i < size; ++i) new (metas + i) meta{{i + 1 < size ? i + 1 : none}, {is_free}};
+
+        head.store(pack(0, 0));
+
+        return r;
+    }
+
+    template<class... As>
+    static maybe<T> occupy(As&&... args)
+    {
+        if (slots == nullptr) fatal("pool_of not initialised");
+
+        const std::uint32_t i = pop();
+
+        if (i == none)
+        {
+            failed.fetch_add(1, std::memory_order_relaxed);
+            return maybe<T>{};
+        }
+
+        metas[i].state.store(is_occupied, std::memory_order_relaxed);
+
+        T* p = nullptr;
+
+        try
+        {
+            p = new (slots + i) T(std::forward<As>(args)...);
+        }
+        catch (...)
+        {
+            metas[i].state.store(is_free, std::memory_order_relaxed);
+            push(i);
+            throw;
+        }
+
+        const std::size_t now = occupied.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        for (std::size_t top = high_water.load(std::memory_order_relaxed); (now > top) && ! high_water.compare_exchange_weak(top, now, std::memory_order_relaxed); ) {}
+
+        return maybe<T>{p};
+    }
+
+    // Back to the pool, m becomes Nothing; releasing Nothing has no effect.
+    static void release(maybe<T>& m)
+    {
+        if ( ! m) return;
+
+        const std::uint32_t i = index_of(m.get());
+
+        if (metas[i].state.exchange(is_free, std::memory_order_acq_rel) != is_occupied) fatal("pool_of object released twice");
+
+        m->~T();
+        m = maybe<T>{};
+
+        occupied.fetch_sub(1, std::memory_order_relaxed);
+        push(i);
+    }
+
+    // Snapshot, exact when nobody occupies or releases meanwhile.
+    static occupancy census()
+    {
+        occupancy r;
+
+        for (std::uint32_t i = 0; i < size; ++i) ++((metas[i].state.load(std::memory_order_relaxed) == is_occupied) ? r.occupied : r.free);
+
+        return r;
+    }
+
+    static std::size_t capacity() noexcept { return size; }
+    static std::size_t high_water_mark() noexcept { return high_water.load(); }
+    static std::size_t failed_occupies() noexcept { return failed.load(); }
+
+    // Address range of all the objects, for debugging.
+    static const void* begin() noexcept { return slots; }
+    static const void* end() noexcept { return slots + size; }
+
+ private:
+    static std::uint32_t index_of(const T* p)
+    {
+        const auto* s = reinterpret_cast<const storage*>(p);
+
+        if ((s < slots) || (s >= slots + size)) fatal("pool_of released an object not from the pool");
+
+        return static_cast<std::uint32_t>(s - slots);
+    }
+
+    static std::uint32_t pop()
+    {
+        std::uint64_t h = head.load(std::memory_order_acquire);
+
+        while (index_of(h) != none)
+        {
+            const std::uint32_t next = metas[index_of(h)].next.load(std::memory_order_relaxed);
+
+            if (head.compare_exchange_weak(h, pack(next, tag_of(h) + 1), std::memory_order_acquire, std::memory_order_acquire)) return index_of(h);
+        }
+
+        return none;
+    }
+
+    static void push(std::uint32_t i)
+    {
+        std::uint64_t h = head.load(std::memory_order_relaxed);
+
+        do
+        {
+            metas[i].next.store(index_of(h), std::memory_order_relaxed);
+        }
+        while ( ! head.compare_exchange_weak(h, pack(i, tag_of(h) + 1), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    inline static storage* slots = nullptr;
+    inline static meta* metas = nullptr;
+    inline static std::uint32_t size = 0;
+
+    alignas(64) inline static std::atomic<std::uint64_t> head{pack(none, 0)};
+    alignas(64) inline static std::atomic<std::size_t> occupied{0};
+    inline static std::atomic<std::size_t> high_water{0};
+    inline static std::atomic<std::size_t> failed{0};
+};
+
+
+
+
+
+
+// ------------------------------------
+
+
+struct item
+{
+    explicit item(int v = 0) : value{v} {}
+
+    // Linking an already linked item is a fatal error.
+    void link(item* const element)
+    {
+        item* expected = nullptr;
+
+        if ( ! next.compare_exchange_strong(expected, element, std::memory_order_release)) fatal("item already linked");
+    }
+
+    int value;
+
+ private:
+    friend std::atomic<item*>& next_of(item& i) noexcept { return i.next; }
+
+    std::atomic<item*> next{nullptr};
+};
+
+
+// Members of a list never have a null next -- the last one points here -- so
+// that an item on a list is told apart from an unlinked one.
+template<class T>
+T* list_end() noexcept { return reinterpret_cast<T*>(std::uintptr_t{1}); }
+
+// Pointer and a 16-bit tag in a single word: user space addresses of x86-64
+// and AArch64 fit into the lower 48 bits.
+template<class T>
+struct tagged
+{
+    static_assert(sizeof(T*) == sizeof(std::uint64_t), "64-bit pointers only");
+
+    static std::uint64_t pack(T* p, std::uint16_t tag) { return (std::uint64_t{tag} << 48) | reinterpret_cast<std::uintptr_t>(p); }
+    static T* pointer(std::uint64_t w) { return reinterpret_cast<T*>(w & ((std::uint64_t{1} << 48) - 1)); }
+    static std::uint16_t tag(std::uint64_t w) { return static_cast<std::uint16_t>(w >> 48); }
+};
+
+
+// LIFO list over next_of(T&), any number of threads push and pop. Tag in the
+// head is bumped on every change, a pop that read a head which was popped and
+// pushed back meanwhile (ABA) fails its exchange; 65536 changes while a thread
+// is preempted in between would go unnoticed. A stale pop may read next of an
+// item taken by somebody else, which is harmless as long as the memory stays
+// mapped -- items come from pool_of, it is never unmapped.
+template<class T>
+class intrusive_stack
+{
+    using word = tagged<T>;
+
+ public:
+    void push(const maybe<T>& m) { if (m) push(m.get()); }
+
+    void push(T* e)
+    {
+        std::atomic<T*>& next = next_of(*e);
+
+        if (next.load(std::memory_order_relaxed) != nullptr) fatal("item already linked");
+
+        std::uint64_t h = top.load(std::memory_order_relaxed);
+
+        do
+        {
+            next.store(word::pointer(h) ? word::pointer(h) : list_end<T>(), std::memory_order_relaxed);
+        }
+        while ( ! top.compare_exchange_weak(h, word::pack(e, word::tag(h) + 1), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    maybe<T> pop()
+    {
+        std::uint64_t h = top.load(std::memory_order_acquire);
+
+        while (T* e = word::pointer(h))
+        {
+            T* next = next_of(*e).load(std::memory_order_relaxed);
+
+            if (top.compare_exchange_weak(h, word::pack((next == list_end<T>()) ? nullptr : next, word::tag(h) + 1), std::memory_order_acquire, std::memory_order_acquire))
+            {
+                next_of(*e).store(nullptr, std::memory_order_relaxed);
+
+                return maybe<T>{e};
+            }
+        }
+
+        return maybe<T>{};
+    }
+
+ private:
+    alignas(64) std::atomic<std::uint64_t> top{word::pack(nullptr, 0)};
+};
+
+
+// FIFO list over next_of(T&): any number of threads push, one pops (Vyukov's
+// intrusive queue). Push is a single exchange, and the only moment a pop can
+// see is the one between a producer's exchange and its link: the queue looks
+// empty then. No ABA, the consumer alone moves the front. A stub T stands in
+// when the queue is empty, T must be default constructible.
+template<class T>
+class intrusive_queue
+{
+ public:
+    intrusive_queue() { next_of(stub).store(list_end<T>(), std::memory_order_relaxed); }
+
+    intrusive_queue(const intrusive_queue&) = delete;
+    intrusive_queue& operator= (const intrusive_queue&) = delete;
+
+    void push(const maybe<T>& m) { if (m) push(m.get()); }
+
+    void push(T* e)
+    {
+        std::atomic<T*>& next = next_of(*e);
+
+        if (next.load(std::memory_order_relaxed) != nullptr) fatal("item already linked");
+
+        next.store(list_end<T>(), std::memory_order_relaxed);
+
+        T* prev = back.exchange(e, std::memory_order_acq_rel);
+
+        next_of(*prev).store(e, std::memory_order_release);
+    }
+
+    // Single consumer.
+    maybe<T> pop()
+    {
+        T* e = front;
+        T* next = next_of(*e).load(std::memory_order_acquire);
+
+        if (e == &stub)
+        {
+            if (next == list_end<T>()) return maybe<T>{};
+
+            next_of(stub).store(nullptr, std::memory_order_relaxed);  // off the queue
+
+            front = e = next;
+            next = next_of(*e).load(std::memory_order_acquire);
+        }
+
+        if (next != list_end<T>()) return unlinked(e, next);
+
+        if (e != back.load(std::memory_order_acquire)) return maybe<T>{};  // a producer is in between
+
+        push(&stub);  // so that e has a successor
+
+        next = next_of(*e).load(std::memory_order_acquire);
+
+        return (next != list_end<T>()) ? unlinked(e, next) : maybe<T>{};
+    }
+
+ private:
+    maybe<T> unlinked(T* e, T* next)
+    {
+        front = next;
+        next_of(*e).store(nullptr, std::memory_order_relaxed);
+
+        return maybe<T>{e};
+    }
+
+    T stub;
+    alignas(64) std::atomic<T*> back{&stub};
+    alignas(64) T* front = &stub;
+};
+
+
+
+// ---
+
+
+template<class F>
+double ms(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    f();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<class F>
+void in_parallel(std::size_t threads, F f)
+{
+    std::vector<std::thread> workers;
+
+    for (std::size_t t = 0; t < threads; ++t) workers.emplace_back(f, t);
+
+    for (auto& w : workers) w.join();
+}
+
+
+constexpr std::size_t threads = 4;
+constexpr std::size_t items = 1024;  // on the stack
+constexpr std::size_t rounds = 1'000'000;  // per thread
+
+
+// Every thread pops an item and pushes it back; at the end all the items are
+// there, each of them once.
+double stack_churn(intrusive_stack<item>& s)
+{
+    return ms([&s]
+    {
+        in_parallel(threads, [&s](std::size_t)
+        {
+            for (std::size_t i = 0; i < rounds; ++i)
+            {
+                const maybe<item> m = s.pop();
+
+                m->value += 1;
+                s.push(m);
+            }
+        });
+    });
+}
+
+double locked_stack_churn(std::mutex& m, std::list<item*>& s)
+{
+    return ms([&m, &s]
+    {
+        in_parallel(threads, [&m, &s](std::size_t)
+        {
+            for (std::size_t i = 0; i < rounds; ++i)
+            {
+                item* e = nullptr;
+
+                {
+                    std::lock_guard<std::mutex> lock{m};
+
+                    e = s.front();
+                    s.pop_front();
+                }
+
+                e->value += 1;
+
+                std::lock_guard<std::mutex> lock{m};
+
+                s.push_front(e);
+            }
+        });
+    });
+}
+
+
+// threads - 1 producers occupy items numbered in order and push them, a
+// consumer pops, checks the order per producer and releases them.
+double queue_flow(bool& in_order)
+{
+    intrusive_queue<item> q;
+    std::array<int, threads> last;
+    last.fill(-1);
+
+    in_order = true;
+
+    const double t = ms([&]
+    {
+        in_parallel(threads, [&](std::size_t id)
+        {
+            constexpr std::size_t consumer = 0;
+
+            if (id != consumer)
+            {
+                for (std::size_t i = 0; i < rounds; )
+                {
+                    const maybe<item> m = pool_of<item>::occupy(static_cast<int>(i * threads + id));
+
+                    if ( ! m) { std::this_thread::yield(); continue; }  // all in flight
+
+                    q.push(m);
+                    ++i;
+                }
+
+                return;
+            }
+
+            for (std::size_t n = 0; n < rounds * (threads - 1); )
+            {
+                maybe<item> m = q.pop();
+
+                if ( ! m) { std::this_thread::yield(); continue; }
+
+                const int from = m->value % static_cast<int>(threads);
+
+                in_order = in_order && (m->value > last[from]);
+                last[from] = m->value;
+
+                pool_of<item>::release(m);
+                ++n;
+            }
+        });
+    });
+
+    return t;
+}
+
+double locked_queue_flow()
+{
+    std::mutex m;
+    std::list<item*> q;
+
+    return ms([&]
+    {
+        in_parallel(threads, [&](std::size_t id)
+        {
+            if (id != 0)
+            {
+                for (std::size_t i = 0; i < rounds; )
+                {
+                    maybe<item> e = pool_of<item>::occupy(static_cast<int>(i));
+
+                    if ( ! e) { std::this_thread::yield(); continue; }
+
+                    std::lock_guard<std::mutex> lock{m};
+
+                    q.push_back(e.get());
+                    ++i;
+                }
+
+                return;
+            }
+
+            for (std::size_t n = 0; n < rounds * (threads - 1); )
+            {
+                maybe<item> e;
+
+                {
+                    std::lock_guard<std::mutex> lock{m};
+
+                    if ( ! q.empty()) { e = maybe<item>{q.front()}; q.pop_front(); }
+                }
+
+                if ( ! e) { std::this_thread::yield(); continue; }
+
+                pool_of<item>::release(e);
+                ++n;
+            }
+        });
+    });
+}
+
+
+
+int main()
+{
+    pool_of<item>::init(1 << 16);
+
+    {
+        maybe<item> nothing;
+        auto next = pool_of<item>::occupy(1);
+
+        nothing.link_or_release(next);  // nobody would own next
+
+        std::cout << "link_or_release on Nothing: next released " << std::boolalpha << ( ! next) << ", occupied " << pool_of<item>::census().occupied << '\n';
+
+        auto head = pool_of<item>::occupy(1);
+        auto other = pool_of<item>::occupy(2);
+
+        head.link_or_release(other);
+
+        std::cout << "link_or_release on item: linked " << bool{other} << ", occupied " << pool_of<item>::census().occupied << '\n';
+
+        pool_of<item>::release(head);
+        pool_of<item>::release(other);
+    }
+
+    intrusive_stack<item> s;
+    std::vector<maybe<item>> all;
+
+    for (std::size_t i = 0; i < items; ++i) all.push_back(pool_of<item>::occupy(0));
+    for (const auto& m : all) s.push(m);
+
+    const double lock_free_stack = stack_churn(s);
+
+    std::size_t popped = 0, total = 0;
+
+    for (maybe<item> m; (m = s.pop()); ++popped) total += static_cast<std::size_t>(m->value);
+
+    std::cout << "stack: " << popped << " items, " << total << " pops, expected " << items << ", " << threads * rounds << '\n';
+
+    std::mutex m;
+    std::list<item*> locked{};
+
+    for (const auto& e : all) locked.push_front(e.get());
+
+    const double locked_stack = locked_stack_churn(m, locked);
+
+    for (auto& e : all) pool_of<item>::release(e);
+
+    bool in_order = false;
+
+    const double lock_free_queue = queue_flow(in_order);
+
+    std::cout << "queue: in order per producer " << in_order << ", occupied " << pool_of<item>::census().occupied << '\n';
+
+    const double locked_queue = locked_queue_flow();
+
+    std::cout << threads << " threads, " << std::thread::hardware_concurrency() << " cores\n";
+    std::cout << "stack, " << rounds << " pop+push per thread: intrusive " << lock_free_stack << " ms, std::list+mutex " << locked_stack << " ms\n";
+    std::cout << "queue, " << threads - 1 << " x " << rounds << " items: intrusive " << lock_free_queue << " ms, std::list+mutex " << locked_queue << " ms\n";
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+link_or_release on Nothing: next released true, occupied 0
+link_or_release on item: linked true, occupied 2
+stack: 1024 items, 4000000 pops, expected 1024, 4000000
+queue: in order per producer true, occupied 0
+4 threads, 1 cores
+stack, 1000000 pop+push per thread: intrusive 152.701 ms, std::list+mutex 256.508 ms
+queue, 3 x 1000000 items: intrusive 196.092 ms, std::list+mutex 517.575 ms
+*/
@@ -0,0 +1,458 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout, cerr
+
+#include <array>  // array
+#include <atomic>  // atomic
+#include <chrono>  // steady_clock
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t
+#include <cstdlib>  // abort
+#include <limits>  // numeric_limits
+#include <memory>  // unique_ptr, make_unique
+#include <mutex>  // mutex, lock_guard
+#include <new>  // placement new
+#include <optional>  // optional, nullopt
+#include <thread>  // thread
+#include <type_traits>  // is_nothrow_default_constructible, is_invocable_r
+#include <utility>  // pair, forward
+#include <vector>  // vector
+
+
+
+[[noreturn]] void fatal(const char* what)
+{
+    std::cerr << "fatal: " << what << std::endl;
+    std::abort();
+}
+
+
+// Fixed number of uninitialised T slots, allocated once upon construction.
+// Any number of threads allocate and deallocate, nothing throws after
+// construction. Free slots form a stack of indices: deallocate pushes
+// without a lock; allocations lock, so that no two of them pop at the same
+// time -- which is what makes the stack free of ABA -- and allocate_n pops
+// a whole batch under a single lock.
+template<class T>
+class shared_pool
+{
+    static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+    struct storage
+    {
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+ public:
+
+    explicit shared_pool(std::size_t capacity)
+        : slots{new storage[checked(capacity)]}
+        , next{new std::atomic<std::uint32_t>[capacity]}
+        , taken{new std::atomic<bool>[capacity]}
+        , size{static_cast<std::uint32_t>(capacity)}
+    {
+        for (std::uint32_t i = 0; i < size; ++i)
+        {
+            next[i].store(i + 1 < size ? i + 1 : none, std::memory_order_relaxed);
+            taken[i].store(false, std::memory_order_relaxed);
+        }
+
+        head.store(0, std::memory_order_release);
+    }
+
+    shared_pool(const shared_pool&) = delete;
+    shared_pool& operator=(const shared_pool&) = delete;
+
+    // Uninitialised slot, nullptr if there is none.
+    void* allocate() noexcept
+    {
+        std::lock_guard<std::mutex> lock{poppers};
+
+        return at(pop());
+    }
+
+    // Up to n slots under one lock, returns how many were written to out.
+    std::size_t allocate_n(void** out, std::size_t n) noexcept
+    {
+        std::lock_guard<std::mutex> lock{poppers};
+
+        std::size_t k = 0;
+
+        for (std::uint32_t i; (k < n) && ((i = pop()) != none); ++k) out[k] = at(i);
+
+        return k;
+    }
+
+    // Slot back to the pool, its object already destroyed (or never made).
+    void deallocate(const void* p) noexcept { push(release(p)); }
+
+    // Destroys the object and gives its slot back. A second release is
+    // caught before the object is destroyed again.
+    void destroy(const T* t) noexcept
+    {
+        const std::uint32_t i = release(t);
+
+        t->~T();
+        push(i);
+    }
+
+    std::size_t capacity() const noexcept { return size; }
+
+ private:
+
+    static std::size_t checked(std::size_t capacity)
+    {
+        if (capacity == 0 || capacity >= none) fatal("shared_pool capacity out of range");
+
+        return capacity;
+    }
+
+    // Index of a taken slot, which is no longer taken.
+    std::uint32_t release(const void* p) noexcept
+    {
+        const auto* s = static_cast<const storage*>(p);
+
+        if ((s < slots.get()) || (s >= slots.get() + size)) fatal("shared_pool deallocated a slot not from the pool");
+
+        const auto i = static_cast<std::uint32_t>(s - slots.get());
+
+        if ( ! taken[i].exchange(false, std::memory_order_relaxed)) fatal("shared_pool slot deallocated twice");
+
+        return i;
+    }
+
+    void push(std::uint32_t i) noexcept
+    {
+        std::uint32_t h = head.load(std::memory_order_relaxed);
+
+        do
+        {
+            next[i].store(h, std::memory_order_relaxed);
+        }
+        while ( ! head.compare_exchange_weak(h, i, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Poppers hold the lock: nobody else pops, so next of the head is stable.
+    std::uint32_t pop() noexcept
+    {
+        std::uint32_t h = head.load(std::memory_order_acquire);
+
+        while ((h != none) && ! head.compare_exchange_weak(h, next[h].load(std::memory_order_relaxed), std::memory_order_acquire, std::memory_order_acquire)) {}
+
+        return h;
+    }
+
+    void* at(std::uint32_t i) noexcept
+    {
+        if (i == none) return nullptr;
+
+        taken[i].store(true, std::memory_order_relaxed);
+
+        return slots.get() + i;
+    }
+
+    std::unique_ptr<storage[]> slots;
+    std::unique_ptr<std::atomic<std::uint32_t>[]> next;
+    std::unique_ptr<std::atomic<bool>[]> taken;
+    std::uint32_t size;
+
+    std::mutex poppers;
+    alignas(64) std::atomic<std::uint32_t> head{none};
+};
+
+
+// The layer of type-level-modelling-example.md over a shared_pool. Objects
+// are default constructed in the pool and given to f : T& -> E before the
+// caller gets them read-only; E::no_error from f hands the object over, any
+// other result puts it back, and so does an exception from f, which is
+// rethrown. Nothing else on the take path allocates from the heap or throws.
+template<class T>
+class layer
+{
+    static_assert(std::is_nothrow_default_constructible_v<T>, "take must not throw");
+    static_assert(std::is_nothrow_destructible_v<T>, "release must not throw");
+
+ public:
+
+    enum class E { no_error, error, no_memory };
+
+    // Puts the object back to the pool it is from. Only a layer makes one.
+    class D
+    {
+        friend class layer;
+
+        explicit D(shared_pool<T>& p) noexcept : pool{&p} {}
+
+        shared_pool<T>* pool;
+
+     public:
+
+        void operator() (const T* t) const noexcept
+        {
+            if (nullptr != t) pool->destroy(t);  // twice is a fatal error
+        }
+    };
+
+    using handle = std::unique_ptr<const T, D>;
+    using result = std::pair<E, std::optional<handle>>;
+
+    explicit layer(std::size_t capacity) : pool{capacity} {}
+
+    template<class F>
+    result take(F&& f) noexcept(std::is_nothrow_invocable_v<F, T&>)
+    {
+        static_assert(std::is_invocable_r_v<E, F, T&>, "f : T& -> E");
+
+        return make(pool.allocate(), f);
+    }
+
+    result take() noexcept
+    {
+        return take([](T&) noexcept { return E::no_error; });
+    }
+
+    // N objects, the locking amortised: one lock for all of them.
+    template<std::size_t N, class F>
+    std::array<result, N> take_n(F&& f) noexcept(std::is_nothrow_invocable_v<F, T&>)
+    {
+        static_assert(std::is_invocable_r_v<E, F, T&>, "f : T& -> E");
+
+        std::array<void*, N> slots{};
+        std::array<result, N> r;
+
+        const std::size_t k = pool.allocate_n(slots.data(), N);
+        std::size_t i = 0;
+
+        try
+        {
+            for (; i < N; ++i) r[i] = make(slots[i], f);
+        }
+        catch (...)
+        {
+            // slot i is back already, objects made before it go with r
+            for (++i; i < k; ++i) pool.deallocate(slots[i]);
+
+            throw;
+        }
+
+        return r;
+    }
+
+    // Applies f to the object if there is one.
+    template<class F>
+    static E augment(const std::optional<handle>& v, F&& f)
+    {
+        static_assert(std::is_invocable_r_v<E, F, const T&>, "f : const T& -> E");
+
+        return v ? f(**v) : E::error;
+    }
+
+ private:
+
+    template<class F>
+    result make(void* slot, F& f) noexcept(std::is_nothrow_invocable_v<F, T&>)
+    {
+        if (nullptr == slot) return {E::no_memory, std::nullopt};
+
+        T* t = new (slot) T{};
+        E e = E::error;
+
+        try
+        {
+            e = f(*t);
+        }
+        catch (...)
+        {
+            pool.destroy(t);
+            throw;
+        }
+
+        if (E::no_error != e)
+        {
+            pool.destroy(t);
+
+            return {e, std::nullopt};
+        }
+
+        return {E::no_error, handle{t, D{pool}}};
+    }
+
+    shared_pool<T> pool;
+};
+
+// ------------------------------------
+
+// relatively small fixed-size data, fetched from the layer below and transformed
+struct source
+{
+    std::array<std::uint32_t, 16> raw;
+};
+
+struct transformed
+{
+    std::array<float, 16> value;
+};
+
+using A = layer<transformed>;
+
+A::E transform(const source& s, transformed& t) noexcept
+{
+    for (std::size_t i = 0; i < s.raw.size(); ++i) t.value[i] = static_cast<float>(s.raw[i]) * 0.5f;
+
+    return A::E::no_error;
+}
+
+// ---
+
+template<class F>
+double ms(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    f();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+constexpr std::size_t batch = 16;
+constexpr std::size_t rounds = 1 << 18;  // batches per thread
+
+// Every thread takes batch transformed objects, reads them and drops them.
+template<class Take>
+double churn(std::size_t threads, Take take)
+{
+    return ms([&]
+    {
+        std::vector<std::thread> workers;
+
+        for (std::size_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&take, t]
+            {
+                source s{};
+                float sum = 0;
+
+                for (std::size_t r = 0; r < rounds; ++r)
+                {
+                    s.raw[0] = static_cast<std::uint32_t>(r + t);
+
+                    sum += take(s);
+                }
+
+                if (sum < 0) std::cout << sum;  // never, keeps the work
+            });
+        }
+
+        for (auto& w : workers) w.join();
+    });
+}
+
+
+
+int main()
+{
+    A a{4 * batch};
+
+    {
+        source s{{42}};
+
+        auto r = a.take([&](transformed& t) { return transform(s, t); });
+
+        std::cout << std::boolalpha << "take: " << (r.first == A::E::no_error) << ", value " << (*r.second)->value[0] << '\n';
+
+        const A::E seen = A::augment(r.second, [](const transformed& t) { return (t.value[0] == 21.f) ? A::E::no_error : A::E::error; });
+
+        std::cout << "augment: " << (seen == A::E::no_error) << '\n';
+
+        auto refused = a.take([](transformed&) { return A::E::error; });
+
+        std::cout << "refused by f: " << (refused.first == A::E::error) << ", object " << refused.second.has_value() << '\n';
+
+        std::size_t calls = 0;
+        const auto fails_third = [&calls](transformed&) { if (++calls == 3) throw calls; return A::E::no_error; };
+
+        try { a.take([](transformed&) -> A::E { throw 0; }); } catch (int) {}
+        try { a.take_n<batch>(fails_third); } catch (std::size_t) {}
+
+        std::cout << "thrown by f: " << calls << " calls, no slot lost (see below)\n";
+
+        auto all = a.take_n<4 * batch>([&](transformed& t) { return transform(s, t); });
+        std::size_t given = 0;
+
+        for (const auto& x : all) given += (x.first == A::E::no_error);
+
+        std::cout << "take_n over capacity: " << given << " given, last " << (all.back().first == A::E::no_memory ? "no_memory" : "?") << '\n';
+
+        // (*r.second)->value[0] = 0;  // error: assignment of read-only location
+        // (*r.second).get_deleter()((*r.second).get());  // compiles; the second release of the slot is a fatal error
+    }
+
+    auto one_by_one = [&a](const source& s)
+    {
+        std::array<A::result, batch> held;
+
+        for (auto& h : held) h = a.take([&](transformed& t) { return transform(s, t); });
+
+        float sum = 0;
+
+        for (const auto& h : held) A::augment(h.second, [&](const transformed& t) { sum += t.value[0]; return A::E::no_error; });
+
+        return sum;
+    };
+
+    auto batched = [&a](const source& s)
+    {
+        auto held = a.take_n<batch>([&](transformed& t) { return transform(s, t); });
+
+        float sum = 0;
+
+        for (const auto& h : held) A::augment(h.second, [&](const transformed& t) { sum += t.value[0]; return A::E::no_error; });
+
+        return sum;
+    };
+
+    auto unique = [](const source& s)
+    {
+        std::array<std::unique_ptr<const transformed>, batch> held;
+
+        for (auto& h : held)
+        {
+            auto t = std::make_unique<transformed>();
+
+            transform(s, *t);
+            h = std::move(t);
+        }
+
+        float sum = 0;
+
+        for (const auto& h : held) sum += h->value[0];
+
+        return sum;
+    };
+
+    std::cout << std::thread::hardware_concurrency() << " cores, " << rounds << " batches of " << batch << " per thread\n";
+
+    for (std::size_t threads : {1, 4})
+    {
+        const double t1 = churn(threads, one_by_one);
+        const double tn = churn(threads, batched);
+        const double mu = churn(threads, unique);
+
+        std::cout << threads << " thread(s): take " << t1 << " ms, take_n " << tn << " ms, make_unique " << mu << " ms\n";
+    }
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+take: true, value 21
+augment: true
+refused by f: true, object false
+thrown by f: 3 calls, no slot lost (see below)
+take_n over capacity: 63 given, last no_memory
+1 cores, 262144 batches of 16 per thread
+1 thread(s): take 262.809 ms, take_n 191.029 ms, make_unique 173.059 ms
+4 thread(s): take 984.287 ms, take_n 733.604 ms, make_unique 738.787 ms
+*/
@@ -0,0 +1,834 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout
+
+#include <algorithm>  // lower_bound, find
+#include <array>  // array
+#include <atomic>  // atomic
+#include <cassert>  // assert
+#include <chrono>  // steady_clock
+#include <condition_variable>  // condition_variable
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t, uint64_t
+#include <limits>  // numeric_limits
+#include <memory>  // unique_ptr
+#include <mutex>  // mutex, lock_guard
+#include <new>  // bad_alloc
+#include <optional>  // optional
+#include <thread>  // thread, yield
+#include <tuple>  // tuple
+#include <utility>  // pair, forward, swap
+#include <vector>  // vector
+
+#include <Eigen/Dense>
+
+
+
+// Prepares a free object for its next user: by default a new value is assigned.
+template<class T>
+struct reuse
+{
+    template<class... As>
+    void operator() (T& t, As&&... args) const { t = T(std::forward<As>(args)...); }
+};
+
+// Keeps the storage, as the size class guarantees the same dimensions.
+template<class S, int R, int C, int O, int MR, int MC>
+struct reuse<Eigen::Matrix<S, R, C, O, MR, MC>>
+{
+    void operator() (Eigen::Matrix<S, R, C, O, MR, MC>& m, Eigen::Index rows, Eigen::Index cols) const { m.resize(rows, cols); }
+};
+
+
+enum class pool_error { none, exhausted, no_memory };
+
+
+template<class F>
+double ms(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    f();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+
+// ------------------------------------
+
+
+// Lock-free size class and pool from coliru/d5072567bab16643.cpp.
+template<class T, std::size_t max>
+class size_class
+{
+    static_assert(max < std::numeric_limits<std::uint32_t>::max(), "indices are 32 bits wide");
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "tagged head must be lock-free");
+
+    static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+    static constexpr std::uint64_t pack(std::uint32_t index, std::uint32_t tag) { return (std::uint64_t{tag} << 32) | index; }
+    static constexpr std::uint32_t index_of(std::uint64_t h) { return static_cast<std::uint32_t>(h); }
+    static constexpr std::uint32_t tag_of(std::uint64_t h) { return static_cast<std::uint32_t>(h >> 32); }
+
+    struct entry
+    {
+        T* object = nullptr;
+        std::atomic<std::uint32_t> next{none};
+    };
+
+ public:
+
+    ~size_class()
+    {
+        assert(free_count() == born.load());  // no handle outlives the pool
+
+        for (auto& e : entries) delete e.object;
+    }
+
+    std::uint32_t pop()
+    {
+        std::uint64_t h = head.load(std::memory_order_acquire);
+
+        while (index_of(h) != none)
+        {
+            const std::uint32_t next = entries[index_of(h)].next.load(std::memory_order_relaxed);
+
+            if (head.compare_exchange_weak(h, pack(next, tag_of(h) + 1), std::memory_order_acquire, std::memory_order_acquire)) return index_of(h);
+        }
+
+        for (std::uint32_t b = born.load(std::memory_order_relaxed); b < max; )
+        {
+            if (born.compare_exchange_weak(b, b + 1, std::memory_order_relaxed)) return b;
+        }
+
+        return none;
+    }
+
+    void push(std::uint32_t i)
+    {
+        std::uint64_t h = head.load(std::memory_order_relaxed);
+
+        do
+        {
+            entries[i].next.store(index_of(h), std::memory_order_relaxed);
+        }
+        while ( ! head.compare_exchange_weak(h, pack(i, tag_of(h) + 1), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    T*& object(std::uint32_t i) { return entries[i].object; }
+
+    static constexpr bool exhausted(std::uint32_t i) { return i == none; }
+
+ private:
+    std::size_t free_count() const
+    {
+        std::size_t n = 0;
+
+        for (std::uint32_t i = index_of(head.load()); i != none; i = entries[i].next.load()) ++n;
+
+        return n;
+    }
+
+    alignas(64) std::atomic<std::uint64_t> head{pack(none, 0)};
+    alignas(64) std::atomic<std::uint32_t> born{0};
+    std::array<entry, max> entries;
+};
+
+
+template<class T, std::size_t max, class K = std::tuple<std::size_t, std::size_t>>
+class lock_free_pool
+{
+    using klass = size_class<T, max>;
+    using snapshot = std::vector<std::pair<K, klass*>>;
+
+    static constexpr auto by_key = [](const std::pair<K, klass*>& e, const K& k) { return e.first < k; };
+
+ public:
+
+    class deleter
+    {
+     public:
+        deleter() = default;
+        deleter(klass* c, std::uint32_t i) : home{c}, index{i} {}
+
+        void operator() (T*) const { home->push(index); }
+
+     private:
+        klass* home = nullptr;
+        std::uint32_t index = 0;
+    };
+
+    using handle = std::unique_ptr<T, deleter>;
+
+    lock_free_pool() : current{snapshots.emplace_back(std::make_unique<snapshot>()).get()} {}
+
+    template<class... As>
+    std::pair<pool_error, std::optional<handle>> construct(const K& k, As&&... args)
+    {
+        klass& c = find_or_add(k);
+
+        const std::uint32_t i = c.pop();
+
+        if (klass::exhausted(i)) return {pool_error::exhausted, std::nullopt};
+
+        T*& p = c.object(i);
+
+        try
+        {
+            if (p == nullptr) p = new T(std::forward<As>(args)...);
+            else reuse<T>{}(*p, std::forward<As>(args)...);
+        }
+        catch (const std::bad_alloc&)
+        {
+            c.push(i);
+            return {pool_error::no_memory, std::nullopt};
+        }
+        catch (...)
+        {
+            c.push(i);
+            throw;
+        }
+
+        return {pool_error::none, handle{p, deleter{&c, i}}};
+    }
+
+ private:
+    static klass* find(const snapshot& s, const K& k)
+    {
+        const auto it = std::lower_bound(s.begin(), s.end(), k, by_key);
+
+        return ((it != s.end()) && (it->first == k)) ? it->second : nullptr;
+    }
+
+    klass& find_or_add(const K& k)
+    {
+        if (klass* c = find(*current.load(std::memory_order_acquire), k)) return *c;
+
+        std::lock_guard<std::mutex> lock{m};
+
+        const snapshot& last = *current.load(std::memory_order_relaxed);
+
+        if (klass* c = find(last, k)) return *c;
+
+        klass* c = classes.emplace_back(std::make_unique<klass>()).get();
+
+        auto next = std::make_unique<snapshot>(last);
+        next->insert(std::lower_bound(next->begin(), next->end(), k, by_key), {k, c});
+
+        current.store(snapshots.emplace_back(std::move(next)).get(), std::memory_order_release);
+
+        return *c;
+    }
+
+    std::mutex m;
+    std::vector<std::unique_ptr<klass>> classes;
+    std::vector<std::unique_ptr<snapshot>> snapshots;
+    std::atomic<const snapshot*> current;
+};
+
+
+
+// ------------------------------------
+
+
+// Bounded stack of free entries of a single size class.
+template<std::size_t M>
+struct magazine
+{
+    bool empty() const noexcept { return count == 0; }
+    bool full() const noexcept { return count == M; }
+
+    std::array<std::uint32_t, M> items;
+    std::size_t count = 0;
+};
+
+
+// Every thread keeps two magazines per size class, filled with free entries
+// (Bonwick's magazines): acquire pops from the loaded one, release pushes
+// into it, the previous one is swapped in when the loaded one runs empty or
+// full. Only when both are exhausted the thread goes to the shared depot of
+// the class and exchanges a whole magazine under its lock: takes a full one
+// on acquire, leaves a full one on release -- one lock per M operations at
+// most, and no shared cache line is touched between. An empty depot falls
+// back to the lock-free class for unborn entries, and when there are none
+// left either, the magazines of all the threads are collected into the depot
+// before exhaustion is reported: free objects cached by a live thread that
+// no longer allocates are not lost. For that, the owner holds its cache
+// (one uncontended exchange on its own cache line) while using it.
+//
+// Magazines go back to the depot when their thread exits, so that the
+// objects remain reachable by the other threads. Pool is destroyed after
+// all the threads stopped using it; its classes then collect the magazines
+// of the threads that are still alive.
+template<class T, std::size_t max, std::size_t M = 16, class K = std::tuple<std::size_t, std::size_t>>
+class magazine_pool
+{
+    struct klass;
+
+    // Per thread state of one class.
+    struct cache
+    {
+        klass* home = nullptr;  // null once the pool is gone
+        std::atomic<bool> busy{false};  // held by the owner while in use, and by collect
+        magazine<M> loaded;
+        magazine<M> previous;
+    };
+
+    // Holds a cache: almost always the owner on its own cache, uncontended.
+    class hold
+    {
+     public:
+        explicit hold(cache& c) : c{c} { while (c.busy.exchange(true, std::memory_order_acquire)) std::this_thread::yield(); }
+        ~hold() { c.busy.store(false, std::memory_order_release); }
+
+        hold(const hold&) = delete;
+        hold& operator= (const hold&) = delete;
+
+     private:
+        cache& c;
+    };
+
+    // All the caches of a thread, indexed by class identifier.
+    struct thread_caches
+    {
+        ~thread_caches()
+        {
+            std::lock_guard<std::mutex> lock{registry()};
+
+            for (auto& c : by_id) if (c && c->home) c->home->detach(*c);
+        }
+
+        std::vector<std::unique_ptr<cache>> by_id;
+    };
+
+    // Guards registration of caches: taken once per thread and class, on
+    // thread exit, on pool destruction, and when a class collects magazines.
+    static std::mutex& registry()
+    {
+        static std::mutex m;
+
+        return m;
+    }
+
+    static thread_caches& local()
+    {
+        static thread_local thread_caches caches;
+
+        return caches;
+    }
+
+    // Class identifiers are reused once their class is gone, so that by_id
+    // of a thread is as long as the most classes alive at once, and a cache
+    // left detached is reset for the next class with its identifier.
+    struct identifiers
+    {
+        std::size_t next = 0;
+        std::vector<std::size_t> released;
+    };
+
+    // Guarded by registry().
+    static identifiers& ids()
+    {
+        static identifiers i;
+
+        return i;
+    }
+
+    static std::size_t next_id()
+    {
+        std::lock_guard<std::mutex> lock{registry()};
+
+        auto& i = ids();
+
+        if (i.released.empty()) return i.next++;
+
+        const std::size_t id = i.released.back();
+        i.released.pop_back();
+
+        return id;
+    }
+
+    struct klass
+    {
+        explicit klass(std::size_t i) : id{i} {}
+
+        ~klass()
+        {
+            std::lock_guard<std::mutex> lock{registry()};
+
+            while ( ! users.empty()) detach(*users.back());
+
+            ids().released.push_back(id);
+
+            for (const auto& g : full) for (std::size_t i = 0; i < g.count; ++i) objects.push(g.items[i]);
+        }
+
+        // Caller holds registry().
+        void detach(cache& c)
+        {
+            {
+                std::lock_guard<std::mutex> lock{m};
+
+                if ( ! c.loaded.empty()) full.push_back(c.loaded);
+                if ( ! c.previous.empty()) full.push_back(c.previous);
+            }
+
+            c.loaded.count = 0;
+            c.previous.count = 0;
+            c.home = nullptr;
+            users.erase(std::find(users.begin(), users.end(), &c));
+        }
+
+        cache& local_cache()
+        {
+            auto& by_id = local().by_id;
+
+            if (by_id.size() <= id) by_id.resize(id + 1);
+
+            if ( ! by_id[id]) by_id[id] = std::make_unique<cache>();
+
+            cache& c = *by_id[id];
+
+            if (c.home != this)  // new, or left by a destroyed class with the same identifier
+            {
+                std::lock_guard<std::mutex> lock{registry()};
+
+                c.home = this;
+                users.push_back(&c);
+            }
+
+            return c;
+        }
+
+        std::uint32_t acquire()
+        {
+            cache& c = local_cache();
+
+            if (const auto i = cached(c); ! size_class<T, max>::exhausted(i)) return i;
+
+            collect();  // all entries are born, free ones may sit in the magazines of other threads
+
+            return cached(c);
+        }
+
+        void release(std::uint32_t i)
+        {
+            cache& c = local_cache();
+            hold h{c};
+
+            if (c.loaded.full()) spill(c);
+
+            c.loaded.items[c.loaded.count++] = i;
+        }
+
+        // From the magazines of the thread, the depot, or unborn entries.
+        std::uint32_t cached(cache& c)
+        {
+            hold h{c};
+
+            if (c.loaded.empty()) refill(c);
+
+            if (c.loaded.empty()) return objects.pop();  // depot is empty as well, take unborn
+
+            return c.loaded.items[--c.loaded.count];
+        }
+
+        // Moves the magazines of all the threads into the depot. Caller holds no cache.
+        void collect()
+        {
+            std::lock_guard<std::mutex> lock{registry()};
+
+            for (cache* u : users)
+            {
+                hold h{*u};
+                std::lock_guard<std::mutex> depot{m};
+
+                if ( ! u->loaded.empty()) full.push_back(u->loaded);
+                if ( ! u->previous.empty()) full.push_back(u->previous);
+
+                u->loaded.count = 0;
+                u->previous.count = 0;
+            }
+        }
+
+        // loaded is empty
+        void refill(cache& c)
+        {
+            if ( ! c.previous.empty()) { std::swap(c.loaded, c.previous); return; }
+
+            std::lock_guard<std::mutex> lock{m};
+
+            if (full.empty()) return;
+
+            c.loaded = full.back();
+            full.pop_back();
+        }
+
+        // loaded is full
+        void spill(cache& c)
+        {
+            if ( ! c.previous.full()) { std::swap(c.loaded, c.previous); return; }
+
+            {
+                std::lock_guard<std::mutex> lock{m};
+
+                full.push_back(c.previous);
+            }
+
+            c.previous = c.loaded;
+            c.loaded.count = 0;
+        }
+
+        const std::size_t id;
+        size_class<T, max> objects;
+        std::mutex m;  // guards the depot
+        std::vector<magazine<M>> full;
+        std::vector<cache*> users;  // guarded by registry()
+    };
+
+    using snapshot = std::vector<std::pair<K, klass*>>;
+
+    static constexpr auto by_key = [](const std::pair<K, klass*>& e, const K& k) { return e.first < k; };
+
+ public:
+
+    using key_type = K;
+
+    // Puts the object into the magazine of the releasing thread.
+    class deleter
+    {
+     public:
+        deleter() = default;
+        deleter(klass* c, std::uint32_t i) : home{c}, index{i} {}
+
+        void operator() (T* p) const
+        {
+            assert(home->objects.object(index) == p);
+
+            home->release(index);
+        }
+
+     private:
+        klass* home = nullptr;
+        std::uint32_t index = 0;
+    };
+
+    using handle = std::unique_ptr<T, deleter>;
+
+    magazine_pool() : current{snapshots.emplace_back(std::make_unique<snapshot>()).get()} {}
+
+    magazine_pool(const magazine_pool&) = delete;
+    magazine_pool& operator= (const magazine_pool&) = delete;
+
+    template<class... As>
+    std::pair<pool_error, std::optional<handle>> construct(const K& k, As&&... args)
+    {
+        klass& c = find_or_add(k);
+
+        const std::uint32_t i = c.acquire();
+
+        if (size_class<T, max>::exhausted(i)) return {pool_error::exhausted, std::nullopt};
+
+        T*& p = c.objects.object(i);
+
+        try
+        {
+            if (p == nullptr) p = new T(std::forward<As>(args)...);
+            else reuse<T>{}(*p, std::forward<As>(args)...);
+        }
+        catch (const std::bad_alloc&)
+        {
+            c.release(i);
+            return {pool_error::no_memory, std::nullopt};
+        }
+        catch (...)
+        {
+            c.release(i);
+            throw;
+        }
+
+        return {pool_error::none, handle{p, deleter{&c, i}}};
+    }
+
+    // Length of the calling thread's table of caches, for diagnostics.
+    static std::size_t thread_table_size() { return local().by_id.size(); }
+
+ private:
+    static klass* find(const snapshot& s, const K& k)
+    {
+        const auto it = std::lower_bound(s.begin(), s.end(), k, by_key);
+
+        return ((it != s.end()) && (it->first == k)) ? it->second : nullptr;
+    }
+
+    klass& find_or_add(const K& k)
+    {
+        if (klass* c = find(*current.load(std::memory_order_acquire), k)) return *c;
+
+        std::lock_guard<std::mutex> lock{m};
+
+        const snapshot& last = *current.load(std::memory_order_relaxed);
+
+        if (klass* c = find(last, k)) return *c;
+
+        klass* c = classes.emplace_back(std::make_unique<klass>(next_id())).get();
+
+        auto next = std::make_unique<snapshot>(last);
+        next->insert(std::lower_bound(next->begin(), next->end(), k, by_key), {k, c});
+
+        current.store(snapshots.emplace_back(std::move(next)).get(), std::memory_order_release);
+
+        return *c;
+    }
+
+    std::mutex m;  // serialises writers only
+    std::vector<std::unique_ptr<klass>> classes;
+    std::vector<std::unique_ptr<snapshot>> snapshots;
+    std::atomic<const snapshot*> current;
+};
+
+
+
+// ---
+
+
+// Objects cached by a thread that exits are taken by another one.
+bool released_on_exit()
+{
+    constexpr std::size_t max = 64;
+
+    magazine_pool<Eigen::MatrixXd, max, 8> pool;
+
+    std::thread{[&pool]
+    {
+        std::vector<magazine_pool<Eigen::MatrixXd, max, 8>::handle> all;
+
+        for (std::size_t i = 0; i < max; ++i) all.push_back(std::move(*pool.construct({3, 3}, 3, 3).second));
+    }}.join();  // all the objects sit in the magazines and depot of a thread that has gone
+
+    std::vector<magazine_pool<Eigen::MatrixXd, max, 8>::handle> all;
+
+    for (std::size_t i = 0; i < max; ++i)
+    {
+        auto h = pool.construct({3, 3}, 3, 3);
+
+        if ( ! h.second) return false;
+
+        all.push_back(std::move(*h.second));
+    }
+
+    return pool.construct({3, 3}, 3, 3).first == pool_error::exhausted;
+}
+
+// Objects cached by a thread that is alive but idle are taken by another one.
+bool collected_from_live()
+{
+    constexpr std::size_t max = 64;
+
+    magazine_pool<Eigen::MatrixXd, max> pool;
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool released = false;
+    bool done = false;
+
+    std::thread idle{[&]
+    {
+        {
+            std::vector<magazine_pool<Eigen::MatrixXd, max>::handle> all;
+
+            for (std::size_t i = 0; i < max; ++i) all.push_back(std::move(*pool.construct({3, 3}, 3, 3).second));
+        }  // all the objects sit in the magazines and depot of this thread
+
+        std::unique_lock<std::mutex> lock{m};
+
+        released = true;
+        cv.notify_one();
+        cv.wait(lock, [&done] { return done; });
+    }};
+
+    bool ok = true;
+
+    {
+        std::unique_lock<std::mutex> lock{m};
+
+        cv.wait(lock, [&released] { return released; });
+    }
+
+    {
+        std::vector<magazine_pool<Eigen::MatrixXd, max>::handle> all;
+
+        for (std::size_t i = 0; ok && (i < max); ++i)
+        {
+            auto h = pool.construct({3, 3}, 3, 3);
+
+            if (h.second) all.push_back(std::move(*h.second));
+            else ok = false;
+        }
+
+        ok = ok && (pool.construct({3, 3}, 3, 3).first == pool_error::exhausted);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock{m};
+
+        done = true;
+        cv.notify_one();
+    }
+
+    idle.join();
+
+    return ok;
+}
+
+// Pools come and go, the table of caches of a thread does not grow with them.
+bool identifiers_reused()
+{
+    using pool_type = magazine_pool<Eigen::MatrixXd, 8>;
+
+    bool ok = true;
+
+    for (int n = 0; n < 1000; ++n)
+    {
+        pool_type pool;
+
+        for (std::size_t side : {2, 3, 4})
+        {
+            auto h = pool.construct({side, side}, side, side);
+
+            ok &= h.second && ((*h.second)->rows() == static_cast<Eigen::Index>(side));
+        }
+    }
+
+    return ok && (pool_type::thread_table_size() == 3);
+}
+
+// Produced by one thread, released by another: objects travel back through the depot.
+bool handed_over()
+{
+    constexpr std::size_t max = 256;
+
+    magazine_pool<Eigen::MatrixXd, max> pool;
+
+    std::mutex m;
+    std::vector<magazine_pool<Eigen::MatrixXd, max>::handle> queue;
+    std::atomic<bool> ok{true};
+
+    std::thread producer{[&]
+    {
+        for (std::size_t i = 0; i < 100'000; )
+        {
+            auto h = pool.construct({4, 4}, 4, 4);
+
+            if ( ! h.second) { std::this_thread::yield(); continue; }  // all in flight, wait for the consumer
+
+            (*h.second)->setConstant(static_cast<double>(i++));
+
+            std::lock_guard<std::mutex> lock{m};
+
+            queue.push_back(std::move(*h.second));
+        }
+    }};
+
+    std::thread consumer{[&]
+    {
+        for (std::size_t n = 0; n < 100'000; )
+        {
+            std::vector<magazine_pool<Eigen::MatrixXd, max>::handle> batch;
+
+            {
+                std::lock_guard<std::mutex> lock{m};
+
+                batch.swap(queue);
+            }
+
+            for (auto& h : batch) if (h->minCoeff() != h->maxCoeff()) ok = false;
+
+            n += batch.size();
+        }
+    }};
+
+    producer.join();
+    consumer.join();
+
+    return ok;
+}
+
+// Same-sized matrices acquired and returned in a tight loop by every thread.
+template<class Acquire>
+double hammer(std::size_t threads, std::size_t rounds, Acquire acquire)
+{
+    return ms([&]
+    {
+        std::vector<std::thread> workers;
+        std::vector<double> sinks(threads);
+
+        for (std::size_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&acquire, &sink = sinks[t], rounds]
+            {
+                for (std::size_t i = 0; i < rounds; ++i)
+                {
+                    auto m = acquire();
+
+                    m->setConstant(static_cast<double>(i));
+                    sink += (*m)(0, 0);
+                }
+            });
+        }
+
+        for (auto& w : workers) w.join();
+    });
+}
+
+
+
+int main()
+{
+    std::cout << "released on thread exit: " << std::boolalpha << released_on_exit() << '\n';
+    std::cout << "collected from live:     " << collected_from_live() << '\n';
+    std::cout << "handed over:             " << handed_over() << '\n';
+    std::cout << "identifiers reused:      " << identifiers_reused() << '\n';
+
+    constexpr std::size_t max = 64;
+    constexpr std::size_t rounds = 4'000'000;
+
+    std::cout << std::thread::hardware_concurrency() << " cores, 4x4\n";
+
+    for (std::size_t threads : {1, 4})
+    {
+        const double plain = hammer(threads, rounds, [] { return std::make_unique<Eigen::MatrixXd>(4, 4); });
+
+        lock_free_pool<Eigen::MatrixXd, max> shared;
+        const double lock_free = hammer(threads, rounds, [&shared] { return std::move(*shared.construct({4, 4}, 4, 4).second); });
+
+        magazine_pool<Eigen::MatrixXd, max> cached;
+        const double magazines = hammer(threads, rounds, [&cached] { return std::move(*cached.construct({4, 4}, 4, 4).second); });
+
+        std::cout << threads << " thread(s) x " << rounds << " rounds\n";
+        std::cout << "  new/delete: " << plain << " ms\n";
+        std::cout << "  lock-free:  " << lock_free << " ms\n";
+        std::cout << "  magazines:  " << magazines << " ms\n";
+    }
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread -I/usr/include/eigen3 main.cpp && ./a.out
+released on thread exit: true
+collected from live:     true
+handed over:             true
+identifiers reused:      true
+1 cores, 4x4
+1 thread(s) x 4000000 rounds
+  new/delete: 187.881 ms
+  lock-free:  176.604 ms
+  magazines:  193.722 ms
+4 thread(s) x 4000000 rounds
+  new/delete: 724.929 ms
+  lock-free:  692.236 ms
+  magazines:  760.779 ms
+*/
@@ -0,0 +1,400 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout
+
+#include <algorithm>  // min
+#include <chrono>  // steady_clock, duration
+#include <cstddef>  // size_t
+#include <cstdlib>  // getenv
+#include <iomanip>  // setw, setprecision
+#include <memory>  // unique_ptr, make_unique
+#include <string>  // string
+#include <tuple>  // tuple, tuple_size, get, tuple_element
+#include <type_traits>  // true_type, false_type, disjunction
+#include <utility>  // index_sequence, forward
+#include <variant>  // variant, visit
+
+
+// Same Testable::foo/bar workload built with every injection technique
+// from testable-design.md and tagged-lambda-injection.md.
+
+
+// Keeps the value alive without generating any code (as in Google Benchmark).
+template<class T>
+inline void do_not_optimize(T& value)
+{
+    asm volatile("" : "+r,m"(value) : : "memory");
+}
+
+
+// Return address seen by the last foo() of a dependency. Inlined into the
+// measuring loop, foo() sees the return address of that loop's function;
+// called out of line, it sees an address inside its caller.
+void* foo_site = nullptr;
+
+[[gnu::always_inline]] inline void at_foo(void* site) { foo_site = site; }
+
+
+// The real dependency: cheap on purpose, so that the injection overhead dominates.
+struct G
+{
+    void foo() { at_foo(__builtin_return_address(0)); ++n; }
+    unsigned bar(unsigned i) { return n + i; }
+
+    unsigned n = 0;  // wraps, the workload only needs it to change
+};
+
+
+// ---
+
+// (1) policy-based design: X<T>
+
+template<class T = G>
+class X : T
+{
+ public:
+    void foo() { T::foo(); }
+
+    unsigned bar(unsigned i)
+    {
+        T::foo();
+
+        return T::bar(i);
+    }
+};
+
+
+// ---
+
+// (2) phantom-tagged lambda expressions: Testable<M<box<Tag, F>...>>
+
+template<class Tuple, template<class> class Predicate>
+class find_in_if
+{
+    template<class T, template<class> class P, std::size_t I>
+    struct box
+    {
+        using                        type  = T;
+        static constexpr std::size_t index = I;
+        static constexpr bool        value = P<T>::value;
+    };
+
+    template<class, class = void>
+    struct find_in_if_impl;
+
+    template<std::size_t... Is, class _>
+    struct find_in_if_impl<std::index_sequence<Is...>, _>
+    {
+        using type =
+            std::disjunction<
+                box<std::tuple_element_t<Is, Tuple>, Predicate, Is>...
+              , box<struct not_found, Predicate, std::tuple_size_v<Tuple>>
+            >;
+    };
+
+ public:
+
+    using type =
+        typename find_in_if_impl<
+            std::make_index_sequence<std::tuple_size_v<Tuple>>
+        >::type;
+};
+
+template<class Tuple, template<class> class Predicate>
+using find_in_if_t = typename find_in_if<Tuple, Predicate>::type;
+
+
+template<class Tag, class F>
+struct box : F
+{
+    using F::operator();
+
+    using type     = F;
+    using tag_type = Tag;
+};
+
+template<class Tag, class F>
+constexpr auto boxify(F f)
+{
+    return box<Tag, F>{f};
+}
+
+template<class Tag>
+class matcher
+{
+    template<class T, class B>
+    struct tag_matcher;
+
+    template<class T, class U, class F>
+    struct tag_matcher<T, box<U, F>> : std::false_type {};
+
+    template<class T, class F>
+    struct tag_matcher<T, box<T, F>> : std::true_type {};
+
+ public:
+
+    template<class Box>
+    using apply = tag_matcher<Tag, Box>;
+};
+
+template<class Tag, class Fs>
+constexpr auto unbox(Fs&& fs)
+{
+    using items = std::remove_reference_t<Fs>;
+    using found = find_in_if_t<items, matcher<Tag>::template apply>;
+
+    static_assert(found::index < std::tuple_size_v<items>, "Tag not found");
+
+    return std::get<found::index>(std::forward<Fs>(fs));
+}
+
+
+template<class Injected>
+struct Testable
+{
+    void foo() { obj.foo(); }
+
+    unsigned bar(unsigned i)
+    {
+        obj.foo();
+
+        return obj.bar(i);
+    }
+
+    Injected obj;
+};
+
+
+struct Foo;
+struct Bar;
+
+template<class... Fs>
+struct M
+{
+    M(Fs... fs) : fs{fs...} {}
+
+    void foo() { unbox<Foo>(fs)(); }
+    unsigned bar(unsigned i) { return unbox<Bar>(fs)(i); }
+
+    std::tuple<Fs...> fs;
+};
+
+
+// ---
+
+// (3) variant-driven PIMPL
+
+struct Mock
+{
+    void foo() { at_foo(__builtin_return_address(0)); ++n; }
+    unsigned bar(unsigned i) { return n - i; }
+
+    unsigned n = 0;
+};
+
+class V
+{
+ public:
+    V() : impl{G{}} {}
+    explicit V(Mock&& m) : impl{std::move(m)} {}
+
+    void foo() { std::visit([](auto& x) { x.foo(); }, impl); }
+
+    unsigned bar(unsigned i)
+    {
+        return std::visit([i](auto& x) { x.foo(); return x.bar(i); }, impl);
+    }
+
+ private:
+    std::variant<Mock, G> impl;
+};
+
+
+// ---
+
+// (4) runtime polymorphism
+
+struct I
+{
+    virtual ~I() = default;
+    virtual void foo() = 0;
+    virtual unsigned bar(unsigned i) = 0;
+};
+
+struct GI final : I, private G
+{
+    void foo() override { G::foo(); }
+    unsigned bar(unsigned i) override { return G::bar(i); }
+};
+
+struct MockI final : I, private Mock
+{
+    void foo() override { Mock::foo(); }
+    unsigned bar(unsigned i) override { return Mock::bar(i); }
+};
+
+class P
+{
+ public:
+    explicit P(I& i) : impl{i} {}
+
+    void foo() { impl.foo(); }
+
+    unsigned bar(unsigned i)
+    {
+        impl.foo();
+
+        return impl.bar(i);
+    }
+
+ private:
+    I& impl;
+};
+
+
+// ---
+
+// (5) linker magic: weak definitions in the tested code, strong ones in a test TU win.
+// The compiler cannot inline a weak symbol, thus the cost is the one of a plain call
+// (plus PLT indirection if the tested code lives in a shared library).
+
+unsigned g_state = 0;
+
+extern "C" __attribute__((weak)) void g_foo() { at_foo(__builtin_return_address(0)); ++g_state; }
+extern "C" __attribute__((weak)) unsigned g_bar(unsigned i) { return g_state + i; }
+
+struct L
+{
+    void foo() { g_foo(); }
+
+    unsigned bar(unsigned i)
+    {
+        g_foo();
+
+        return g_bar(i);
+    }
+};
+
+
+
+// ---
+
+// (0) no injection: the same forwarding shape as everywhere else, straight to G
+
+struct D
+{
+    void foo() { g.foo(); }
+
+    unsigned bar(unsigned i)
+    {
+        g.foo();
+
+        return g.bar(i);
+    }
+
+    G g;
+};
+
+
+
+// ------------------------------------
+
+
+constexpr std::size_t iterations = 50'000'000;
+constexpr std::size_t repetitions = 7;
+
+struct measured
+{
+    double ns;  // per iteration
+    bool inlined;  // the dependency's foo() is compiled into the loop
+};
+
+// Best of repetitions, the least disturbed run is the closest to the real cost.
+template<class T>
+measured measure(T& t)
+{
+    double best = 1e9;
+
+    for (std::size_t r = 0; r < repetitions; ++r)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        for (std::size_t k = 0; k < iterations; ++k)
+        {
+            unsigned i = static_cast<unsigned>(k);
+
+            do_not_optimize(i);  // no constant folding across iterations
+            t.foo();
+            i = t.bar(i);
+            do_not_optimize(i);
+        }
+
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+        best = std::min(best, elapsed.count() / iterations);
+    }
+
+    return {best, foo_site == __builtin_return_address(0)};
+}
+
+template<class T>
+void report(const char* name, T& t, double baseline)
+{
+    const measured m = measure(t);
+
+    std::cout << std::left << std::setw(24) << name
+              << std::right << std::fixed << std::setprecision(3)
+              << std::setw(8) << m.ns << " ns/iter"
+              << std::setw(9) << (m.ns - baseline) << " ns overhead"
+              << ", foo() " << (m.inlined ? "inlined" : "called")
+              << '\n';
+}
+
+
+int main()
+{
+    // selected at run time, so that the compiler cannot devirtualise (4)
+    const bool mocked = std::getenv("USE_MOCK") != nullptr;
+
+    D direct;
+    const measured baseline = measure(direct);
+
+    X<> x;
+    report("policy X<T>", x, baseline.ns);
+
+    G g;  // the same dependency as everywhere else, the lambdas only forward to it
+    M m
+    {
+        boxify<Foo>([&g] { g.foo(); })
+      , boxify<Bar>([&g](unsigned i) { return g.bar(i); })
+    };
+    Testable<decltype(m)> tm{m};
+    report("M<box<Tag, F>...>", tm, baseline.ns);
+
+    V v = mocked ? V{Mock{}} : V{};
+    report("variant PIMPL", v, baseline.ns);
+
+    std::unique_ptr<I> i = mocked ? std::unique_ptr<I>{std::make_unique<MockI>()}
+                                  : std::unique_ptr<I>{std::make_unique<GI>()};
+    P p{*i};
+    report("virtual interface", p, baseline.ns);
+
+    L l;
+    report("linker substitution", l, baseline.ns);
+
+    std::cout << "baseline (direct G)     " << std::setw(8) << baseline.ns << " ns/iter"
+              << std::setw(28) << ", foo() " << (baseline.inlined ? "inlined" : "called") << '\n';
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++20 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+policy X<T>                1.358 ns/iter    0.193 ns overhead, foo() inlined
+M<box<Tag, F>...>          0.620 ns/iter   -0.545 ns overhead, foo() inlined
+variant PIMPL              0.969 ns/iter   -0.195 ns overhead, foo() inlined
+virtual interface          5.155 ns/iter    3.990 ns overhead, foo() called
+linker substitution        6.341 ns/iter    5.176 ns overhead, foo() called
+baseline (direct G)        1.165 ns/iter                    , foo() inlined
+*/
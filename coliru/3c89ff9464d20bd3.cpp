@@ -0,0 +1,678 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout, cerr
+
+#include <array>  // array
+#include <atomic>  // atomic
+#include <chrono>  // steady_clock
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t, uint16_t, uint32_t, uint64_t, uintptr_t
+#include <cstdlib>  // abort
+#include <iterator>  // prev
+#include <limits>  // numeric_limits
+#include <list>  // list
+#include <new>  // placement new
+#include <type_traits>  // invoke_result
+#include <utility>  // forward
+
+#include <sys/mman.h>  // mmap, madvise, mlock
+#include <unistd.h>  // sysconf
+
+
+
+[[noreturn]] void fatal(const char* what)
+{
+    std::cerr << "fatal: " << what << std::endl;
+    std::abort();
+}
+
+
+template<class T>
+class pool_of;
+
+
+// Maybe-like result of occupy: Nothing, or an object in the pool. Does not
+// own the object -- it goes back to the pool with pool_of<T>::release only.
+// Operations on Nothing have no effect, dereferencing it is a fatal error.
+template<class T>
+class maybe
+{
+ public:
+    maybe() = default;  // Nothing
+    explicit maybe(T* _p) : p{_p} {}
+
+    explicit operator bool() const noexcept { return p != nullptr; }
+
+    T& operator*() const { if (p == nullptr) fatal("Nothing dereferenced"); return *p; }
+    T* operator->() const { return &**this; }
+
+    T* get() const noexcept { return p; }
+
+    // f : T& -> maybe<U>
+    template<class F>
+    std::invoke_result_t<F, T&> and_then(F&& f) const { return p ? f(*p) : std::invoke_result_t<F, T&>{}; }
+
+    // Links the objects if both are there.
+    template<class U>
+    void link(const maybe<U>& next) const { if (p && next) p->link(next.get()); }
+
+    // Links the objects if both are there, otherwise next goes back to its
+    // pool: nobody would own it once this is Nothing.
+    template<class U>
+    void link_or_release(maybe<U>& next) const
+    {
+        if (p) link(next);
+        else pool_of<U>::release(next);
+    }
+
+ private:
+    T* p = nullptr;
+};
+
+
+struct region_options
+{
+    bool huge_pages = false;  // explicit huge pages if reserved, transparent ones otherwise
+    bool lock = false;  // mlock: never swapped out
+    bool populate = true;  // all the pages faulted in upon init
+};
+
+struct region_status
+{
+    std::size_t bytes = 0;
+    bool huge_pages = false;  // explicit huge pages (MAP_HUGETLB) were used
+    bool locked = false;
+};
+
+// Number of slots in each state; everything is preallocated, nothing is unborn.
+struct occupancy
+{
+    std::size_t free = 0;
+    std::size_t occupied = 0;
+};
+
+
+
+// ------------------------------------
+
+
+// Pool from coliru/3f1f7afeb51db795.cpp.
+//
+// Fixed number of T objects in a single mmap-ed region, mapped once upon
+// system start with init() and never unmapped. Free slots form a lock-free
+// stack of indices with a tagged head (see coliru/d5072567bab16643.cpp);
+// objects are constructed in place on occupy and destroyed on release.
+// Running out of slots gives Nothing, releasing twice or releasing what is
+// not from the pool is a fatal error.
+template<class T>
+class pool_of
+{
+    static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+    static constexpr std::uint64_t pack(std::uint32_t index, std::uint32_t tag) { return (std::uint64_t{tag} << 32) | index; }
+    static constexpr std::uint32_t index_of(std::uint64_t h) { return static_cast<std::uint32_t>(h); }
+    static constexpr std::uint32_t tag_of(std::uint64_t h) { return static_cast<std::uint32_t>(h >> 32); }
+
+    enum : std::uint8_t { is_free, is_occupied };
+
+    struct meta
+    {
+        std::atomic<std::uint32_t> next;
+        std::atomic<std::uint8_t> state;
+    };
+
+    struct storage
+    {
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "tagged head must be lock-free");
+    static_assert(alignof(T) <= 4096, "objects are placed at the start of the region");
+
+ public:
+
+    static region_status init(std::size_t capacity, region_options o = region_options{})
+    {
+        if (slots != nullptr) fatal("pool_of initialised twice");
+        if (capacity == 0 || capacity >= none) fatal("pool_of capacity out of range");
+
+        const std::size_t objects = capacity * sizeof(storage);
+        const std::size_t meta_at = (objects + alignof(meta) - 1) / alignof(meta) * alignof(meta);
+        const std::size_t page = o.huge_pages ? (std::size_t{2} << 20) : static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+        region_status r;
+        r.bytes = (meta_at + capacity * sizeof(meta) + page - 1) / page * page;
+
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS | (o.populate ? MAP_POPULATE : 0);
+        void* base = MAP_FAILED;
+
+        if (o.huge_pages)
+        {
+            base = ::mmap(nullptr, r.bytes, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+            r.huge_pages = (base != MAP_FAILED);
+        }
+
+        if (base == MAP_FAILED)
+        {
+            // not reserved: transparent huge pages if enabled (before the pages are faulted in)
+            base = ::mmap(nullptr, r.bytes, PROT_READ | PROT_WRITE, (flags & ~MAP_POPULATE), -1, 0);
+
+            if (base == MAP_FAILED) fatal("pool_of region cannot be mapped");
+
+            if (o.huge_pages) ::madvise(base, r.bytes, MADV_HUGEPAGE);
+            if (o.populate) for (std::size_t b = 0; b < r.bytes; b += 4096) static_cast<volatile unsigned char*>(base)[b] = 0;
+        }
+
+        r.locked = o.lock && (::mlock(base, r.bytes) == 0);
+
+        slots = static_cast<storage*>(base);
+        metas = reinterpret_cast<meta*>(static_cast<unsigned char*>(base) + meta_at);
+        size = static_cast<std::uint32_t>(capacity);
+
+        for (std::uint32_t i = 0; i < size; ++i) new (metas + i) meta{{i + 1 < size ? i + 1 : none}, {is_free}};
+
+        head.store(pack(0, 0));
+
+        return r;
+    }
+
+    template<class... As>
+    static maybe<T> occupy(As&&... args)
+    {
+        if (slots == nullptr) fatal("pool_of not initialised");
+
+        const std::uint32_t i = pop();
+
+        if (i == none)
+        {
+            failed.fetch_add(1, std::memory_order_relaxed);
+            return maybe<T>{};
+        }
+
+        metas[i].state.store(is_occupied, std::memory_order_relaxed);
+
+        T* p = nullptr;
+
+        try
+        {
+            p = new (slots + i) T(std::forward<As>(args)...);
+        }
+        catch (...)
+        {
+            metas[i].state.store(is_free, std::memory_order_relaxed);
+            push(i);
+            throw;
+        }
+
+        const std::size_t now = occupied.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        for (std::size_t top = high_water.load(std::memory_order_relaxed); (now > top) && ! high_water.compare_exchange_weak(top, now, std::memory_order_relaxed); ) {}
+
+        return maybe<T>{p};
+    }
+
+    // Back to the pool, m becomes Nothing; releasing Nothing has no effect.
+    static void release(maybe<T>& m)
+    {
+        if ( ! m) return;
+
+        const std::uint32_t i = index_of(m.get());
+
+        if (metas[i].state.exchange(is_free, std::memory_order_acq_rel) != is_occupied) fatal("pool_of object released twice");
+
+        m->~T();
+        m = maybe<T>{};
+
+        occupied.fetch_sub(1, std::memory_order_relaxed);
+        push(i);
+    }
+
+    // Snapshot, exact when nobody occupies or releases meanwhile.
+    static occupancy census()
+    {
+        occupancy r;
+
+        for (std::uint32_t i = 0; i < size; ++i) ++((metas[i].state.load(std::memory_order_relaxed) == is_occupied) ? r.occupied : r.free);
+
+        return r;
+    }
+
+    static std::size_t capacity() noexcept { return size; }
+    static std::size_t high_water_mark() noexcept { return high_water.load(); }
+    static std::size_t failed_occupies() noexcept { return failed.load(); }
+
+    // Address range of all the objects, for debugging.
+    static const void* begin() noexcept { return slots; }
+    static const void* end() noexcept { return slots + size; }
+
+ private:
+    static std::uint32_t index_of(const T* p)
+    {
+        const auto* s = reinterpret_cast<const storage*>(p);
+
+        if ((s < slots) || (s >= slots + size)) fatal("pool_of released an object not from the pool");
+
+        return static_cast<std::uint32_t>(s - slots);
+    }
+
+    static std::uint32_t pop()
+    {
+        std::uint64_t h = head.load(std::memory_order_acquire);
+
+        while (index_of(h) != none)
+        {
+            const std::uint32_t next = metas[index_of(h)].next.load(std::memory_order_relaxed);
+
+            if (head.compare_exchange_weak(h, pack(next, tag_of(h) + 1), std::memory_order_acquire, std::memory_order_acquire)) return index_of(h);
+        }
+
+        return none;
+    }
+
+    static void push(std::uint32_t i)
+    {
+        std::uint64_t h = head.load(std::memory_order_relaxed);
+
+        do
+        {
+            metas[i].next.store(index_of(h), std::memory_order_relaxed);
+        }
+        while ( ! head.compare_exchange_weak(h, pack(i, tag_of(h) + 1), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    inline static storage* slots = nullptr;
+    inline static meta* metas = nullptr;
+    inline static std::uint32_t size = 0;
+
+    alignas(64) inline static std::atomic<std::uint64_t> head{pack(none, 0)};
+    alignas(64) inline static std::atomic<std::size_t> occupied{0};
+    inline static std::atomic<std::size_t> high_water{0};
+    inline static std::atomic<std::size_t> failed{0};
+};
+
+
+
+
+
+
+// ------------------------------------
+
+
+// A link slot is named by a tag type. Tags derived from doubly_linked get
+// a back link as well, for lists that unlink from the middle.
+struct doubly_linked {};
+
+template<class Tag, class Self, bool = std::is_base_of_v<doubly_linked, Tag>>
+struct link_slot
+{
+    std::atomic<Self*> next{nullptr};
+};
+
+template<class Tag, class Self>
+struct link_slot<Tag, Self, true>
+{
+    std::atomic<Self*> next{nullptr};
+    Self* prev = nullptr;
+};
+
+template<class Tag, class... Ts>
+inline constexpr bool one_of = (std::is_same_v<Tag, Ts> + ... + 0) == 1;
+
+template<class... Ts>
+inline constexpr bool unique_tags = (one_of<Ts, Ts...> && ...);
+
+
+// Payload together with one link slot per list the object may sit on at
+// once. Slots are base classes, so that they take no more room than the
+// pointers themselves, and a list reaches its own slot by the tag.
+template<class Payload, class... Links>
+class item : link_slot<Links, item<Payload, Links...>>...
+{
+    static_assert(sizeof...(Links) > 0, "an item without links is its payload");
+    static_assert(unique_tags<Links...>, "each list needs its own slot");
+
+ public:
+
+    template<class Tag>
+    static constexpr bool has_link = one_of<Tag, Links...>;
+
+    template<class... As>
+    explicit item(As&&... args) : value(std::forward<As>(args)...) {}
+
+    Payload value;
+
+    template<class Tag>
+    static link_slot<Tag, item>& slot_of(item& i) noexcept
+    {
+        static_assert(has_link<Tag>, "item has no link slot for this list");
+
+        return i;
+    }
+};
+
+template<class T, class Tag>
+inline constexpr bool has_link_v = T::template has_link<Tag>;
+
+
+template<class T>
+T* list_end() noexcept { return reinterpret_cast<T*>(std::uintptr_t{1}); }
+
+template<class T>
+struct tagged
+{
+    static_assert(sizeof(T*) == sizeof(std::uint64_t), "64-bit pointers only");
+
+    static std::uint64_t pack(T* p, std::uint16_t tag) { return (std::uint64_t{tag} << 48) | reinterpret_cast<std::uintptr_t>(p); }
+    static T* pointer(std::uint64_t w) { return reinterpret_cast<T*>(w & ((std::uint64_t{1} << 48) - 1)); }
+    static std::uint16_t tag(std::uint64_t w) { return static_cast<std::uint16_t>(w >> 48); }
+};
+
+
+// Lock-free LIFO list from coliru/0334c0a5bfd9319e.cpp, over the Tag slot.
+template<class T, class Tag>
+class intrusive_stack
+{
+    static_assert(has_link_v<T, Tag>, "item has no link slot for this list");
+
+    using word = tagged<T>;
+
+    static std::atomic<T*>& next_of(T& e) noexcept { return T::template slot_of<Tag>(e).next; }
+
+ public:
+    void push(T* e)
+    {
+        std::atomic<T*>& next = next_of(*e);
+
+        if (next.load(std::memory_order_relaxed) != nullptr) fatal("item already linked");
+
+        std::uint64_t h = top.load(std::memory_order_relaxed);
+
+        do
+        {
+            next.store(word::pointer(h) ? word::pointer(h) : list_end<T>(), std::memory_order_relaxed);
+        }
+        while ( ! top.compare_exchange_weak(h, word::pack(e, word::tag(h) + 1), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    maybe<T> pop()
+    {
+        std::uint64_t h = top.load(std::memory_order_acquire);
+
+        while (T* e = word::pointer(h))
+        {
+            T* next = next_of(*e).load(std::memory_order_relaxed);
+
+            if (top.compare_exchange_weak(h, word::pack((next == list_end<T>()) ? nullptr : next, word::tag(h) + 1), std::memory_order_acquire, std::memory_order_acquire))
+            {
+                next_of(*e).store(nullptr, std::memory_order_relaxed);
+
+                return maybe<T>{e};
+            }
+        }
+
+        return maybe<T>{};
+    }
+
+ private:
+    alignas(64) std::atomic<std::uint64_t> top{word::pack(nullptr, 0)};
+};
+
+
+// Doubly linked list over the Tag slot, for a single thread (or under the
+// owner's lock): O(1) unlink from anywhere, as an LRU list needs.
+template<class T, class Tag>
+class intrusive_dlist
+{
+    static_assert(has_link_v<T, Tag>, "item has no link slot for this list");
+    static_assert(std::is_base_of_v<doubly_linked, Tag>, "list needs a doubly linked slot");
+
+    static auto& slot(T& e) noexcept { return T::template slot_of<Tag>(e); }
+
+ public:
+    bool empty() const noexcept { return first == nullptr; }
+    std::size_t size() const noexcept { return count; }
+
+    T* front() const noexcept { return first; }
+    T* back() const noexcept { return last; }
+
+    static bool linked(T& e) noexcept { return slot(e).next.load(std::memory_order_relaxed) != nullptr; }
+
+    void push_front(T& e)
+    {
+        if (linked(e)) fatal("item already linked");
+
+        slot(e).prev = nullptr;
+        slot(e).next.store(first ? first : list_end<T>(), std::memory_order_relaxed);
+
+        (first ? slot(*first).prev : last) = &e;
+        first = &e;
+        ++count;
+    }
+
+    void erase(T& e)
+    {
+        if ( ! linked(e)) fatal("item not linked");
+
+        T* next = slot(e).next.load(std::memory_order_relaxed);
+        T* prev = slot(e).prev;
+
+        if (next == list_end<T>()) last = prev;
+        else slot(*next).prev = prev;
+
+        if (prev == nullptr) first = (next == list_end<T>()) ? nullptr : next;
+        else slot(*prev).next.store(next, std::memory_order_relaxed);
+
+        slot(e).next.store(nullptr, std::memory_order_relaxed);
+        slot(e).prev = nullptr;
+        --count;
+    }
+
+    void move_to_front(T& e) { erase(e); push_front(e); }
+
+ private:
+    T* first = nullptr;
+    T* last = nullptr;
+    std::size_t count = 0;
+};
+
+
+
+// ---
+
+
+// Cache entries: free list shared by all threads, LRU order of the whole
+// cache, and the entries of each session, so that a session ending drops
+// only its own entries.
+struct free_list {};
+struct lru : doubly_linked {};
+struct session : doubly_linked {};
+struct audit : doubly_linked {};  // not a list entries are on
+
+struct record
+{
+    record(std::uint32_t s, std::uint64_t k) : owner{s}, key{k} {}
+
+    std::uint32_t owner;
+    std::uint64_t key;
+};
+
+using entry = item<record, free_list, lru, session>;
+
+static_assert(has_link_v<entry, lru> && ! has_link_v<entry, audit>);
+static_assert(sizeof(entry) == sizeof(record) + 5 * sizeof(void*), "the links, nothing else");
+
+// Both would fail to compile:
+// intrusive_dlist<entry, audit> a;  // item has no link slot for this list
+// intrusive_dlist<entry, free_list> f;  // list needs a doubly linked slot
+
+
+constexpr std::size_t sessions = 64;
+constexpr std::size_t capacity = 4096;  // cached entries
+constexpr std::size_t rounds = 4'000'000;
+
+
+template<class F>
+double ms(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    f();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Every round caches an entry for a random session and evicts the least
+// recently used one when full; now and then the oldest entry of a session
+// is used again, and from time to time a session ends.
+struct workload
+{
+    template<class Insert, class Touch, class End>
+    void operator() (Insert insert, Touch touch, End end) const
+    {
+        std::uint64_t x = 7;  // xorshift, cheaper than the distributions
+
+        const auto next = [&x] { x ^= x << 13; x ^= x >> 7; x ^= x << 17; return x; };
+
+        for (std::size_t i = 0; i < rounds; ++i)
+        {
+            const std::uint64_t r = next();
+            const auto s = static_cast<std::uint32_t>(r % sessions);
+
+            insert(s, i);
+
+            if ((r >> 8) % 4 == 0) touch(static_cast<std::uint32_t>((r >> 16) % sessions));
+            if ((r >> 24) % 10'000 == 0) end(s);
+        }
+    }
+};
+
+
+// Intrusive: one object, two lists, no allocation after the pool is set up.
+double intrusive(std::size_t& evicted)
+{
+    intrusive_dlist<entry, lru> order;
+    std::array<intrusive_dlist<entry, session>, sessions> by_session;
+
+    const auto drop = [&](entry& e)
+    {
+        order.erase(e);
+        by_session[e.value.owner].erase(e);
+
+        maybe<entry> m{&e};
+        pool_of<entry>::release(m);
+    };
+
+    return ms([&]
+    {
+        workload{}([&](std::uint32_t s, std::uint64_t key)
+        {
+            if (order.size() == capacity) { drop(*order.back()); ++evicted; }
+
+            maybe<entry> m = pool_of<entry>::occupy(s, key);
+
+            order.push_front(*m);
+            by_session[s].push_front(*m);
+        }
+        , [&](std::uint32_t s)
+        {
+            if ( ! by_session[s].empty()) order.move_to_front(*by_session[s].back());
+        }
+        , [&](std::uint32_t s)
+        {
+            while ( ! by_session[s].empty()) drop(*by_session[s].front());
+        });
+    });
+}
+
+// Same with std::list: the LRU list holds the entries, a session list holds
+// iterators to them, and the entry keeps its iterator in the session list to
+// unlink itself -- a node allocated per membership.
+double standard(std::size_t& evicted)
+{
+    struct plain_entry;
+
+    using order_list = std::list<plain_entry>;
+    using session_list = std::list<order_list::iterator>;
+
+    struct plain_entry
+    {
+        record value;
+        session_list::iterator in_session;
+    };
+
+    order_list order;
+    std::array<session_list, sessions> by_session;
+
+    const auto drop = [&](order_list::iterator e)
+    {
+        by_session[e->value.owner].erase(e->in_session);
+        order.erase(e);
+    };
+
+    return ms([&]
+    {
+        workload{}([&](std::uint32_t s, std::uint64_t key)
+        {
+            if (order.size() == capacity) { drop(std::prev(order.end())); ++evicted; }
+
+            order.push_front(plain_entry{record{s, key}, {}});
+            order.front().in_session = by_session[s].insert(by_session[s].begin(), order.begin());
+        }
+        , [&](std::uint32_t s)
+        {
+            if ( ! by_session[s].empty()) order.splice(order.begin(), order, by_session[s].back());
+        }
+        , [&](std::uint32_t s)
+        {
+            while ( ! by_session[s].empty()) drop(by_session[s].front());
+        });
+    });
+}
+
+
+
+int main()
+{
+    pool_of<entry>::init(capacity + 1);
+
+    {
+        intrusive_stack<entry, free_list> free;
+        intrusive_dlist<entry, lru> order;
+        intrusive_dlist<entry, session> mine;
+
+        auto e = pool_of<entry>::occupy(1, 42);
+
+        order.push_front(*e);
+        mine.push_front(*e);  // same object, second list
+        free.push(e.get());  // and third
+
+        std::cout << "one entry on three lists: " << std::boolalpha << ((order.front() == e.get()) && (mine.front() == e.get()) && (free.pop().get() == e.get())) << '\n';
+
+        order.erase(*e);
+        mine.erase(*e);
+        pool_of<entry>::release(e);
+    }
+
+    std::cout << "sizeof(record) " << sizeof(record) << ", sizeof(entry) " << sizeof(entry) << '\n';
+
+    std::size_t a = 0, b = 0;
+
+    const double with_links = intrusive(a);
+    const double with_lists = standard(b);
+
+    std::cout << rounds << " rounds, " << sessions << " sessions, " << capacity << " entries cached, " << a << " evicted (" << b << ")\n";
+    std::cout << "intrusive: " << with_links << " ms\n";
+    std::cout << "std::list: " << with_lists << " ms\n";
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+one entry on three lists: true
+sizeof(record) 16, sizeof(entry) 56
+4000000 rounds, 64 sessions, 4096 entries cached, 3968741 evicted (3968741)
+intrusive: 335.121 ms
+std::list: 290.422 ms
+*/
@@ -0,0 +1,674 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout, cerr, ostream
+
+#include <algorithm>  // min
+#include <array>  // array
+#include <atomic>  // atomic
+#include <chrono>  // steady_clock
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t, uint32_t, uint64_t
+#include <cstdlib>  // abort, free
+#include <limits>  // numeric_limits
+#include <memory>  // unique_ptr
+#include <mutex>  // mutex, lock_guard
+#include <new>  // placement new
+#include <string>  // string
+#include <thread>  // thread
+#include <type_traits>  // invoke_result
+#include <unordered_map>  // unordered_map
+#include <utility>  // forward
+#include <vector>  // vector
+
+#include <cxxabi.h>  // __cxa_demangle
+#include <execinfo.h>  // backtrace, backtrace_symbols
+#include <sys/mman.h>  // mmap, madvise, mlock
+#include <unistd.h>  // sysconf
+
+
+
+[[noreturn]] void fatal(const char* what)
+{
+    std::cerr << "fatal: " << what << std::endl;
+    std::abort();
+}
+
+
+// Maybe-like result of occupy: Nothing, or an object in the pool. Does not
+// own the object -- it goes back to the pool with pool_of<T>::release only.
+// Operations on Nothing have no effect, dereferencing it is a fatal error.
+template<class T>
+class maybe
+{
+ public:
+    maybe() = default;  // Nothing
+    explicit maybe(T* _p) : p{_p} {}
+
+    explicit operator bool() const noexcept { return p != nullptr; }
+
+    T& operator*() const { if (p == nullptr) fatal("Nothing dereferenced"); return *p; }
+    T* operator->() const { return &**this; }
+
+    T* get() const noexcept { return p; }
+
+    // f : T& -> maybe<U>
+    template<class F>
+    std::invoke_result_t<F, T&> and_then(F&& f) const { return p ? f(*p) : std::invoke_result_t<F, T&>{}; }
+
+    // Links the objects if both are there.
+    template<class U>
+    void link(const maybe<U>& next) const { if (p && next) p->link(next.get()); }
+
+ private:
+    T* p = nullptr;
+};
+
+
+struct region_options
+{
+    bool huge_pages = false;  // explicit huge pages if reserved, transparent ones otherwise
+    bool lock = false;  // mlock: never swapped out
+    bool populate = true;  // all the pages faulted in upon init
+};
+
+struct region_status
+{
+    std::size_t bytes = 0;
+    bool huge_pages = false;  // explicit huge pages (MAP_HUGETLB) were used
+    bool locked = false;
+};
+
+// Number of slots in each state; everything is preallocated, nothing is unborn.
+struct occupancy
+{
+    std::size_t free = 0;
+    std::size_t occupied = 0;
+};
+
+
+
+// ------------------------------------
+
+
+// Histogram and acquire sites from coliru/befb837df8cbf08a.cpp: observed<> wraps
+// pools that hand out owning handles, pool_of takes them as its Watch instead.
+
+// Counts of durations in power of two nanosecond ranges: [0, 2), [2, 4), [4, 8), ...
+class latency_histogram
+{
+ public:
+    static constexpr std::size_t ranges = 40;
+
+    void record(std::chrono::nanoseconds d)
+    {
+        const auto ns = static_cast<std::uint64_t>(d.count());
+
+        counts[std::min<std::size_t>(ns ? 64 - __builtin_clzll(ns) : 0, ranges - 1)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Upper bound of the range that holds the p-th fraction of the samples.
+    std::uint64_t percentile(double p) const
+    {
+        std::size_t total = 0;
+
+        for (const auto& c : counts) total += c.load(std::memory_order_relaxed);
+
+        std::size_t seen = 0;
+
+        for (std::size_t i = 0; i < ranges; ++i)
+        {
+            seen += counts[i].load(std::memory_order_relaxed);
+
+            if ((total > 0) && (seen >= p * total)) return std::uint64_t{1} << i;
+        }
+
+        return 0;
+    }
+
+ private:
+    std::array<std::atomic<std::size_t>, ranges> counts{};
+};
+
+
+// Nothing is recorded besides the counters (default).
+struct unwatched
+{
+    static constexpr bool with_latency = false;
+
+    void acquired(const void*) {}
+    void released(const void*) {}
+
+    std::size_t report(std::ostream&) const { return 0; }
+};
+
+// Acquire latency is recorded.
+struct timed : unwatched
+{
+    static constexpr bool with_latency = true;
+};
+
+// "binary(mangled+offset) [address]" into "function+offset", as far as it goes.
+std::string symbolise(const char* frame)
+{
+    const std::string s = frame;
+    const auto open = s.find('('), plus = s.find('+', open);
+
+    if ((open == std::string::npos) || (plus == std::string::npos) || (plus == open + 1)) return s;
+
+    int status = 0;
+    char* name = abi::__cxa_demangle(s.substr(open + 1, plus - open - 1).c_str(), nullptr, nullptr, &status);
+
+    const std::string r = (status == 0) ? name + s.substr(plus, s.find(')', plus) - plus) : s;
+
+    std::free(name);
+
+    return r;
+}
+
+// Debug mode: the latency, and the call stack of every occupy kept until the
+// object is released; whatever is left has leaked. Stacks are symbolised
+// only in the report (link with -rdynamic to see function names).
+class acquire_sites
+{
+    static constexpr int depth = 8;
+
+    struct trace
+    {
+        std::array<void*, depth> frames;
+        int size;
+    };
+
+ public:
+    static constexpr bool with_latency = true;
+
+    void acquired(const void* p)
+    {
+        trace t;
+        t.size = ::backtrace(t.frames.data(), depth);
+
+        std::lock_guard<std::mutex> lock{m};
+
+        outstanding[p] = t;
+    }
+
+    void released(const void* p)
+    {
+        std::lock_guard<std::mutex> lock{m};
+
+        outstanding.erase(p);
+    }
+
+    std::size_t report(std::ostream& os) const
+    {
+        std::lock_guard<std::mutex> lock{m};
+
+        for (const auto& [p, t] : outstanding)
+        {
+            os << "outstanding " << p << " acquired at:\n";
+
+            char** symbols = ::backtrace_symbols(t.frames.data(), t.size);
+
+            for (int i = 0; i < t.size; ++i) os << "    " << (symbols ? symbolise(symbols[i]) : "?") << '\n';
+
+            std::free(symbols);
+        }
+
+        return outstanding.size();
+    }
+
+ private:
+    mutable std::mutex m;
+    std::unordered_map<const void*, trace> outstanding;
+};
+
+
+// What a pool reports when asked.
+struct pool_report
+{
+    occupancy slots;
+    std::size_t high_water = 0;  // most objects occupied at once
+    std::size_t failed = 0;  // occupies that gave Nothing
+    std::uint64_t p50 = 0, p99 = 0, p999 = 0;  // occupy latency, ns; zero if not timed
+};
+
+std::ostream& operator<< (std::ostream& os, const pool_report& r)
+{
+    return os << "free " << r.slots.free << ", occupied " << r.slots.occupied
+              << ", high water " << r.high_water << ", failed " << r.failed
+              << "; occupy p50 < " << r.p50 << " ns, p99 < " << r.p99 << " ns, p99.9 < " << r.p999 << " ns";
+}
+
+
+
+// ------------------------------------
+
+
+// Fixed number of T objects in a single mmap-ed region, mapped once upon
+// system start with init() and never unmapped. Free slots form a lock-free
+// stack of indices with a tagged head (see coliru/d5072567bab16643.cpp);
+// objects are constructed in place on occupy and destroyed on release.
+// Running out of slots gives Nothing, releasing twice or releasing what is
+// not from the pool is a fatal error. Watch is unwatched, timed or acquire_sites.
+template<class T, class Watch = unwatched>
+class pool_of
+{
+    static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+    static constexpr std::uint64_t pack(std::uint32_t index, std::uint32_t tag) { return (std::uint64_t{tag} << 32) | index; }
+    static constexpr std::uint32_t index_of(std::uint64_t h) { return static_cast<std::uint32_t>(h); }
+    static constexpr std::uint32_t tag_of(std::uint64_t h) { return static_cast<std::uint32_t>(h >> 32); }
+
+    enum : std::uint8_t { is_free, is_occupied };
+
+    struct meta
+    {
+        std::atomic<std::uint32_t> next;
+        std::atomic<std::uint8_t> state;
+    };
+
+    struct storage
+    {
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "tagged head must be lock-free");
+    static_assert(alignof(T) <= 4096, "objects are placed at the start of the region");
+
+ public:
+
+    static region_status init(std::size_t capacity, region_options o = region_options{})
+    {
+        if (slots != nullptr) fatal("pool_of initialised twice");
+        if (capacity == 0 || capacity >= none) fatal("pool_of capacity out of range");
+
+        const std::size_t objects = capacity * sizeof(storage);
+        const std::size_t meta_at = (objects + alignof(meta) - 1) / alignof(meta) * alignof(meta);
+        const std::size_t page = o.huge_pages ? (std::size_t{2} << 20) : static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+        region_status r;
+        r.bytes = (meta_at + capacity * sizeof(meta) + page - 1) / page * page;
+
+        const int flags = MAP_PRIVATE | MAP_ANONYMOUS | (o.populate ? MAP_POPULATE : 0);
+        void* base = MAP_FAILED;
+
+        if (o.huge_pages)
+        {
+            base = ::mmap(nullptr, r.bytes, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+            r.huge_pages = (base != MAP_FAILED);
+        }
+
+        if (base == MAP_FAILED)
+        {
+            // not reserved: transparent huge pages if enabled (before the pages are faulted in)
+            base = ::mmap(nullptr, r.bytes, PROT_READ | PROT_WRITE, (flags & ~MAP_POPULATE), -1, 0);
+
+            if (base == MAP_FAILED) fatal("pool_of region cannot be mapped");
+
+            if (o.huge_pages) ::madvise(base, r.bytes, MADV_HUGEPAGE);
+            if (o.populate) for (std::size_t b = 0; b < r.bytes; b += 4096) static_cast<volatile unsigned char*>(base)[b] = 0;
+        }
+
+        r.locked = o.lock && (::mlock(base, r.bytes) == 0);
+
+        slots = static_cast<storage*>(base);
+        metas = reinterpret_cast<meta*>(static_cast<unsigned char*>(base) + meta_at);
+        size = static_cast<std::uint32_t>(capacity);
+
+        for (std::uint32_t i = 0; i < size; ++i) new (metas + i) meta{{i + 1 < size ? i + 1 : none}, {is_free}};
+
+        head.store(pack(0, 0));
+
+        return r;
+    }
+
+    template<class... As>
+    static maybe<T> occupy(As&&... args)
+    {
+        if constexpr ( ! Watch::with_latency) return take(std::forward<As>(args)...);
+
+        const auto start = std::chrono::steady_clock::now();
+
+        maybe<T> m = take(std::forward<As>(args)...);
+
+        latency.record(std::chrono::steady_clock::now() - start);
+
+        if (m) watch.acquired(m.get());
+
+        return m;
+    }
+
+    // Back to the pool, m becomes Nothing; releasing Nothing has no effect.
+    static void release(maybe<T>& m)
+    {
+        if ( ! m) return;
+
+        const std::uint32_t i = index_of(m.get());
+
+        if (metas[i].state.exchange(is_free, std::memory_order_acq_rel) != is_occupied) fatal("pool_of object released twice");
+
+        watch.released(m.get());
+
+        m->~T();
+        m = maybe<T>{};
+
+        occupied.fetch_sub(1, std::memory_order_relaxed);
+        push(i);
+    }
+
+    // Snapshot, exact when nobody occupies or releases meanwhile.
+    static occupancy census()
+    {
+        occupancy r;
+
+        for (std::uint32_t i = 0; i < size; ++i) ++((metas[i].state.load(std::memory_order_relaxed) == is_occupied) ? r.occupied : r.free);
+
+        return r;
+    }
+
+    static std::size_t capacity() noexcept { return size; }
+    static std::size_t high_water_mark() noexcept { return high_water.load(); }
+    static std::size_t failed_occupies() noexcept { return failed.load(); }
+
+    static pool_report report()
+    {
+        pool_report r;
+
+        r.slots = census();
+        r.high_water = high_water.load();
+        r.failed = failed.load();
+        r.p50 = latency.percentile(0.5);
+        r.p99 = latency.percentile(0.99);
+        r.p999 = latency.percentile(0.999);
+
+        return r;
+    }
+
+    // Number of objects out, with their acquire sites if watched so. The pool
+    // is never destroyed, thus there is no report at shutdown: call it there.
+    static std::size_t leaks(std::ostream& os)
+    {
+        watch.report(os);
+
+        return occupied.load();
+    }
+
+    // Address range of all the objects, for debugging.
+    static const void* begin() noexcept { return slots; }
+    static const void* end() noexcept { return slots + size; }
+
+ private:
+    template<class... As>
+    static maybe<T> take(As&&... args)
+    {
+        if (slots == nullptr) fatal("pool_of not initialised");
+
+        const std::uint32_t i = pop();
+
+        if (i == none)
+        {
+            failed.fetch_add(1, std::memory_order_relaxed);
+            return maybe<T>{};
+        }
+
+        metas[i].state.store(is_occupied, std::memory_order_relaxed);
+
+        T* p = nullptr;
+
+        try
+        {
+            p = new (slots + i) T(std::forward<As>(args)...);
+        }
+        catch (...)
+        {
+            metas[i].state.store(is_free, std::memory_order_relaxed);
+            push(i);
+            throw;
+        }
+
+        const std::size_t now = occupied.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        for (std::size_t top = high_water.load(std::memory_order_relaxed); (now > top) && ! high_water.compare_exchange_weak(top, now, std::memory_order_relaxed); ) {}
+
+        return maybe<T>{p};
+    }
+
+    static std::uint32_t index_of(const T* p)
+    {
+        const auto* s = reinterpret_cast<const storage*>(p);
+
+        if ((s < slots) || (s >= slots + size)) fatal("pool_of released an object not from the pool");
+
+        return static_cast<std::uint32_t>(s - slots);
+    }
+
+    static std::uint32_t pop()
+    {
+        std::uint64_t h = head.load(std::memory_order_acquire);
+
+        while (index_of(h) != none)
+        {
+            const std::uint32_t next = metas[index_of(h)].next.load(std::memory_order_relaxed);
+
+            if (head.compare_exchange_weak(h, pack(next, tag_of(h) + 1), std::memory_order_acquire, std::memory_order_acquire)) return index_of(h);
+        }
+
+        return none;
+    }
+
+    static void push(std::uint32_t i)
+    {
+        std::uint64_t h = head.load(std::memory_order_relaxed);
+
+        do
+        {
+            metas[i].next.store(index_of(h), std::memory_order_relaxed);
+        }
+        while ( ! head.compare_exchange_weak(h, pack(i, tag_of(h) + 1), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    inline static storage* slots = nullptr;
+    inline static meta* metas = nullptr;
+    inline static std::uint32_t size = 0;
+
+    alignas(64) inline static std::atomic<std::uint64_t> head{pack(none, 0)};
+    alignas(64) inline static std::atomic<std::size_t> occupied{0};
+    inline static std::atomic<std::size_t> high_water{0};
+    inline static std::atomic<std::size_t> failed{0};
+
+    inline static latency_histogram latency;
+    inline static Watch watch;
+};
+
+
+
+// ---
+
+
+struct item
+{
+    explicit item(int v = 0) : value{v} {}
+
+    // Linking an already linked item is a fatal error.
+    void link(item* const element)
+    {
+        item* expected = nullptr;
+
+        if ( ! next.compare_exchange_strong(expected, element, std::memory_order_release)) fatal("item already linked");
+    }
+
+    item* successor() const noexcept { return next.load(std::memory_order_acquire); }
+
+    int value;
+
+ private:
+    std::atomic<item*> next{nullptr};
+};
+
+// Separate pool, same layout, for the first touch measurement.
+struct cold_item : item { using item::item; };
+
+
+template<class F>
+double ms(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    f();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+[[gnu::noinline]] maybe<item> forgotten()
+{
+    return pool_of<item, acquire_sites>::occupy(2);
+}
+
+
+// Every thread occupies and releases batch objects at a time.
+template<class Occupy, class Release>
+double churn(std::size_t threads, std::size_t rounds, Occupy occupy, Release release)
+{
+    return ms([&]
+    {
+        std::vector<std::thread> workers;
+
+        for (std::size_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&occupy, &release, rounds]
+            {
+                constexpr std::size_t batch = 16;
+
+                for (std::size_t i = 0; i < rounds / batch; ++i)
+                {
+                    std::array<decltype(occupy()), batch> held;
+
+                    for (auto& h : held) h = occupy();
+                    for (auto& h : held) release(h);
+                }
+            });
+        }
+
+        for (auto& w : workers) w.join();
+    });
+}
+
+
+
+int main()
+{
+    constexpr std::size_t capacity = 1 << 20;
+
+    region_options o;
+    o.huge_pages = true;
+    o.lock = true;
+
+    const region_status s = pool_of<item>::init(capacity, o);
+
+    std::cout << "region: " << s.bytes / (1 << 20) << " MiB, huge pages " << std::boolalpha << s.huge_pages << ", locked " << s.locked << '\n';
+
+    {
+        auto head = pool_of<item>::occupy(1);
+        auto next = pool_of<item>::occupy(2);
+        head.link(next);
+
+        maybe<item> nothing;
+        nothing.link(next);  // no effect
+
+        std::cout << "linked: " << head->successor()->value << '\n';
+
+        auto doubled = head.and_then([](item& i) { return pool_of<item>::occupy(i.value * 2); });
+
+        std::cout << "and_then: " << doubled->value << ", occupied " << pool_of<item>::census().occupied << '\n';
+
+        for (auto m : {head, next, doubled}) pool_of<item>::release(m);
+    }
+
+    {
+        std::vector<maybe<item>> all;
+
+        for (maybe<item> m; (m = pool_of<item>::occupy()); ) all.push_back(m);
+
+        std::cout << "occupied all " << all.size() << ", then Nothing: failed " << pool_of<item>::failed_occupies() << '\n';
+
+        for (auto& m : all) pool_of<item>::release(m);
+    }
+
+    // debug mode: occupy latency and the call stack of every object out
+    {
+        using watched = pool_of<item, acquire_sites>;
+
+        watched::init(4);
+
+        auto kept = watched::occupy(1);
+        [[maybe_unused]] auto lost = forgotten();
+
+        watched::release(kept);
+
+        std::cout << "leaks: " << watched::leaks(std::cout) << '\n';
+        std::cout << "report: " << watched::report() << '\n';
+    }
+
+    // first touch: prefaulted region against one faulted in on demand
+    {
+        region_options lazy;
+        lazy.populate = false;
+
+        pool_of<cold_item>::init(capacity, lazy);
+
+        std::vector<maybe<item>> warm(capacity);
+        std::vector<maybe<cold_item>> cold(capacity);
+
+        const double w = ms([&] { for (auto& m : warm) m = pool_of<item>::occupy(); });
+        const double c = ms([&] { for (auto& m : cold) m = pool_of<cold_item>::occupy(); });
+
+        std::cout << "occupy " << capacity << " first time: populated " << w << " ms, on demand " << c << " ms\n";
+
+        for (auto& m : warm) pool_of<item>::release(m);
+        for (auto& m : cold) pool_of<cold_item>::release(m);
+    }
+
+    constexpr std::size_t rounds = 4'000'000;
+
+    pool_of<item, timed>::init(capacity);
+
+    std::cout << std::thread::hardware_concurrency() << " cores\n";
+
+    for (std::size_t threads : {1, 4})
+    {
+        const double plain = churn(threads, rounds, [] { return new item; }, [](item* p) { delete p; });
+        const double pooled = churn(threads, rounds, [] { return pool_of<item>::occupy(); }, [](maybe<item>& m) { pool_of<item>::release(m); });
+        const double clocked = churn(threads, rounds, [] { return pool_of<item, timed>::occupy(); }, [](maybe<item>& m) { pool_of<item, timed>::release(m); });
+
+        std::cout << threads << " thread(s) x " << rounds << ": new/delete " << plain << " ms, pool_of " << pooled << " ms, timed " << clocked << " ms\n";
+    }
+
+    std::cout << "timed: " << pool_of<item, timed>::report() << '\n';
+
+    std::cout << "high water " << pool_of<item>::high_water_mark() << '\n';
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread -rdynamic main.cpp && ./a.out
+region: 24 MiB, huge pages false, locked true
+linked: 2
+and_then: 2, occupied 3
+occupied all 1048576, then Nothing: failed 1
+leaks: outstanding 0x7f3c78342010 acquired at:
+    maybe<item> pool_of<item, acquire_sites>::occupy<int>(int&&)+0x114
+    forgotten()+0x16
+    ./a.out(main+0x65b) [0x55fa5e691b9b]
+    /lib/x86_64-linux-gnu/libc.so.6(+0x2724a) [0x7f3c77e4524a]
+    /lib/x86_64-linux-gnu/libc.so.6(__libc_start_main+0x85) [0x7f3c77e45305]
+    ./a.out(_start+0x21) [0x55fa5e6936a1]
+1
+report: free 3, occupied 1, high water 2, failed 0; occupy p50 < 128 ns, p99 < 512 ns, p99.9 < 512 ns
+occupy 1048576 first time: populated 25.8512 ms, on demand 42.6323 ms
+1 cores
+1 thread(s) x 4000000: new/delete 165.027 ms, pool_of 198.153 ms, timed 583.032 ms
+4 thread(s) x 4000000: new/delete 564.754 ms, pool_of 740.344 ms, timed 2247.7 ms
+timed: free 1048576, occupied 0, high water 61, failed 0; occupy p50 < 64 ns, p99 < 128 ns, p99.9 < 256 ns
+high water 1048576
+*/
@@ -0,0 +1,206 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout
+
+#include <algorithm>  // sort
+#include <array>  // array
+#include <cstddef>  // size_t
+#include <string>  // string
+#include <string_view>  // string_view
+#include <tuple>  // tuple
+#include <type_traits>  // is_same
+#include <utility>  // index_sequence, make_index_sequence
+#include <variant>  // variant, variant_size, visit
+
+
+
+// Canonical key of a type: its spelling as given by the compiler. Stable between
+// builds made with the same compiler, which is what the ABI of a variant depends on anyway.
+template<class T>
+constexpr std::string_view key_of()
+{
+    constexpr std::string_view p = __PRETTY_FUNCTION__;  // "... [with T = int; ...]"
+    constexpr auto b = p.find("T = ") + 4;
+
+    // T ends at the first ';' or ']' outside of its own brackets, e.g. std::array<int [2], 3>
+    int depth = 0;
+    auto e = b;
+
+    for (; e < p.size(); ++e)
+    {
+        const char c = p[e];
+
+        if ((c == '<') || (c == '(') || (c == '[')) ++depth;
+        else if ((depth == 0) && ((c == ';') || (c == ']'))) break;
+        else if ((c == '>') || (c == ')') || (c == ']')) --depth;
+    }
+
+    return p.substr(b, e - b);
+}
+
+
+// O(1)-depth indexing into a pack: all the candidates are base classes,
+// overload resolution picks the one with the matching index.
+template<std::size_t I, class T>
+struct indexed { using type = T; };
+
+template<class Is, class... Ts>
+struct indexer;
+
+template<std::size_t... Is, class... Ts>
+struct indexer<std::index_sequence<Is...>, Ts...> : indexed<Is, Ts>... {};
+
+template<std::size_t I, class T>
+indexed<I, T> select(indexed<I, T>);
+
+template<std::size_t I, class... Ts>
+using nth_t = typename decltype(select<I>(indexer<std::index_sequence_for<Ts...>, Ts...>{}))::type;
+
+
+
+// ------------------------------------
+
+
+// Order is computed in a single constant expression over the keys, no recursive
+// instantiations (a sort over types would need one per comparison). Uniqueness is
+// decided by the types themselves: keys only order them, and distinct types
+// that the compiler spells the same (e.g. two lambdas of one function) are
+// refused, since their order could not be canonical.
+template<class... Ts>
+class normalize_variant
+{
+    struct order
+    {
+        std::array<std::size_t, sizeof...(Ts)> indices{};
+        std::size_t size = 0;
+        bool ambiguous = false;
+    };
+
+    // Index of the first occurrence of T in Ts.
+    template<class T>
+    static constexpr std::size_t first_of()
+    {
+        constexpr bool same[] = {std::is_same_v<T, Ts>...};
+
+        std::size_t i = 0;
+
+        while ( ! same[i]) ++i;
+
+        return i;
+    }
+
+    static constexpr order canonical = []
+    {
+        constexpr std::array<std::string_view, sizeof...(Ts)> keys{key_of<Ts>()...};
+        constexpr std::array<std::size_t, sizeof...(Ts)> first{first_of<Ts>()...};
+
+        order r;
+
+        for (std::size_t i = 0; i < keys.size(); ++i)
+        {
+            if (first[i] == i) r.indices[r.size++] = i;
+        }
+
+        const auto less = [&keys](std::size_t a, std::size_t b) { return keys[a] < keys[b]; };
+
+        std::sort(r.indices.begin(), r.indices.begin() + r.size, less);
+
+        for (std::size_t i = 1; i < r.size; ++i)
+        {
+            r.ambiguous |= (keys[r.indices[i - 1]] == keys[r.indices[i]]);
+        }
+
+        return r;
+    }();
+
+    static_assert( ! canonical.ambiguous, "distinct types with the same key");
+
+    template<std::size_t... Is>
+    static auto make(std::index_sequence<Is...>)
+        -> std::variant<nth_t<canonical.indices[Is], Ts...>...>;
+
+ public:
+
+    using type = decltype(make(std::make_index_sequence<canonical.size>{}));
+};
+
+template<class... Ts>
+using normalize_variant_t = typename normalize_variant<Ts...>::type;
+
+
+// Accepts an already built variant, or any other type list.
+template<class V>
+struct normalize;
+
+template<template<class...> class L, class... Ts>
+struct normalize<L<Ts...>> : normalize_variant<Ts...> {};
+
+template<class V>
+using normalize_t = typename normalize<V>::type;
+
+
+
+// ---
+
+
+struct A {};
+struct B {};
+
+
+using v1 = normalize_variant_t<int, std::string, A, int, double, A>;
+using v2 = normalize_variant_t<A, double, std::string, int>;
+using v3 = normalize_t<std::tuple<double, B, A, B, int, std::string, int>>;
+
+static_assert(std::is_same_v<v1, v2>, "same set of types, same variant");
+static_assert(std::variant_size_v<v1> == 4);
+static_assert(std::variant_size_v<v3> == 5);
+static_assert(std::is_same_v<normalize_t<v1>, v1>, "idempotent");
+static_assert(std::variant_size_v<normalize_variant_t<std::array<int[2], 3>, std::array<int[2], 4>>> == 2);
+static_assert(std::variant_size_v<normalize_variant_t<int (*)[2], int (*)[3], int (*)[2]>> == 2);  // arrays cannot be alternatives, pointers to them can
+
+// static_assert fails: "distinct types with the same key"
+// auto f = [] {}; auto g = [] {};
+// normalize_variant_t<decltype(f), decltype(g)> w;
+
+
+template<class... Fs>
+struct overloaded : Fs... { using Fs::operator()...; };
+
+template<class... Fs>
+overloaded(Fs...) -> overloaded<Fs...>;
+
+
+
+int main()
+{
+    using raw = std::variant<int, std::string, A, int, double, A>;
+
+    std::cout << "raw:        " << std::variant_size_v<raw> << " alternatives\n";
+    std::cout << "normalised: " << std::variant_size_v<v1> << " alternatives\n";
+
+    std::cout << "order:";
+    [&]<std::size_t... Is>(std::index_sequence<Is...>)
+    {
+        ((std::cout << ' ' << key_of<std::variant_alternative_t<Is, v1>>()), ...);
+    }(std::make_index_sequence<std::variant_size_v<v1>>{});
+    std::cout << '\n';
+
+    v1 v = 3.14;
+
+    std::visit(overloaded
+    {
+        [](double d) { std::cout << "double " << d << '\n'; }
+      , [](const auto&) { std::cout << "other\n"; }
+    }, v);
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++20 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+raw:        6 alternatives
+normalised: 4 alternatives
+order: A double int std::__cxx11::basic_string<char>
+double 3.14
+*/
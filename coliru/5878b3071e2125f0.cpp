@@ -0,0 +1,618 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout
+
+#include <algorithm>  // for_each, max
+#include <cassert>  // assert
+#include <cstddef>  // size_t, ptrdiff_t
+#include <cstdint>  // uint32_t
+#include <cstdlib>  // malloc, free, exit
+#include <memory>  // uninitialized_move, destroy
+#include <new>  // bad_alloc
+#include <string>  // string, to_string
+#include <string_view>  // string_view
+#include <type_traits>  // enable_if, is_convertible, is_nothrow_move_constructible
+#include <utility>  // move
+#include <vector>  // vector
+
+#include <sys/resource.h>  // getrusage
+#include <sys/wait.h>  // waitpid
+#include <unistd.h>  // fork, pipe
+
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/iterator/iterator_categories.hpp>
+
+
+
+// Counts calls to the global allocation functions.
+static std::size_t allocations = 0;
+
+void* operator new(std::size_t n)
+{
+    ++allocations;
+
+    if (void* p = std::malloc(n ? n : 1)) return p;
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+
+
+// ------------------------------------
+
+
+// Tail that can hold up to N children without growing: the first push_back
+// allocates room for exactly N elements in one go, the storage is doubled
+// only past N. Inline storage is not possible here: the tail is a member of
+// the node, thus it cannot contain nodes by value.
+template<class T, std::size_t N>
+class small_tail
+{
+    static_assert(N > 0);
+
+ public:
+
+    using value_type = T;
+    using size_type = std::uint32_t;
+
+    small_tail() = default;
+
+    // Delegates, so that the destructor frees what was copied if a copy throws.
+    small_tail(const small_tail& other) : small_tail{}
+    {
+        reserve(other.count);
+
+        for (; count < other.count; ++count) ::new (items + count) T(other.items[count]);
+    }
+
+    small_tail(small_tail&& other) noexcept
+      : items{other.items}, count{other.count}, capacity{other.capacity}
+    {
+        other.items = nullptr;
+        other.count = other.capacity = 0;
+    }
+
+    small_tail& operator= (small_tail other) noexcept
+    {
+        std::swap(items, other.items);
+        std::swap(count, other.count);
+        std::swap(capacity, other.capacity);
+
+        return *this;
+    }
+
+    ~small_tail()
+    {
+        std::destroy(items, items + count);
+        ::operator delete(items);
+    }
+
+    size_type size() const noexcept { return count; }
+    bool empty() const noexcept { return count == 0; }
+
+    T& operator[] (size_type k) noexcept { assert(k < count); return items[k]; }
+    const T& operator[] (size_type k) const noexcept { assert(k < count); return items[k]; }
+
+    T* data() noexcept { return items; }
+    const T* data() const noexcept { return items; }
+
+    // t may be one of the elements: on growth it is moved before they are relocated.
+    void push_back(T&& t)
+    {
+        if (count < capacity)
+        {
+            ::new (items + count) T(std::move(t));
+            ++count;
+
+            return;
+        }
+
+        const size_type n = capacity ? 2 * capacity : N;
+        T* p = static_cast<T*>(::operator new(n * sizeof(T)));
+
+        try
+        {
+            ::new (p + count) T(std::move(t));
+        }
+        catch (...)
+        {
+            ::operator delete(p);
+            throw;
+        }
+
+        relocate(p, n);
+        ++count;
+    }
+
+    void push_back(const T& t) { push_back(T(t)); }
+
+    void resize(size_type n)
+    {
+        if (n < count) { std::destroy(items + n, items + count); count = n; return; }
+
+        if (n > capacity) reserve(std::max<size_type>(n, N));
+
+        for (; count < n; ++count) ::new (items + count) T();
+    }
+
+    void reserve(size_type n)
+    {
+        if (n <= capacity) return;
+
+        relocate(static_cast<T*>(::operator new(n * sizeof(T))), n);
+    }
+
+ private:
+    // Moves the elements into p of capacity n, which the tail then owns.
+    // Nodes move without throwing, thus there is no rollback.
+    void relocate(T* p, size_type n)
+    {
+        static_assert(std::is_nothrow_move_constructible_v<T>, "relocation cannot be rolled back");
+
+        std::uninitialized_move(items, items + count, p);
+        std::destroy(items, items + count);
+        ::operator delete(items);
+
+        items = p;
+        capacity = n;
+    }
+
+    T* items = nullptr;
+    size_type count = 0;
+    size_type capacity = 0;
+};
+
+
+
+// ---
+
+
+// json_node_type with the tail type made a parameter.
+template<template<class> class Tail>
+class basic_json_node
+{
+    template<class T>
+    class iter
+      : public boost::iterator_facade<iter<T>, T, boost::random_access_traversal_tag>
+    {
+        struct enabler {};
+
+     public:
+        iter() = default;
+
+        explicit iter(T& _n, std::size_t _i = 0)
+          : n{&_n}, i{_i}
+        {}
+
+        template<class U>
+        iter(const iter<U>& other
+          , std::enable_if_t<std::is_convertible<U*, T*>::value, enabler> = enabler{})
+          : n{other.n}, i{other.i}
+        {}
+
+     private:
+        friend class boost::iterator_core_access;
+
+        template<class> friend class iter;
+
+        template<class U>
+        bool equal(const iter<U>& other) const
+        {
+            return (this->i == other.i) && (this->n == other.n);
+        }
+
+        void increment() { assert(i < n->size()); ++i; }
+        void decrement() { assert(i > 0); --i; }
+        void advance(std::ptrdiff_t d) { i += d; }
+
+        template<class U>
+        std::ptrdiff_t distance_to(const iter<U>& other) const
+        {
+            return static_cast<std::ptrdiff_t>(other.i) - static_cast<std::ptrdiff_t>(this->i);
+        }
+
+        T& dereference() const
+        {
+            assert(i < n->size());
+
+            return (i == 0) ? *n : n->tail[i - 1];
+        }
+
+        T* n = nullptr;
+        std::size_t i = 0;
+    };
+
+ public:
+
+    using tail_type = Tail<basic_json_node>;
+    using size_type = std::size_t;
+    using iterator = iter<basic_json_node>;
+    using const_iterator = iter<const basic_json_node>;
+
+    basic_json_node() = default;
+    explicit basic_json_node(std::string d) : data{std::move(d)} {}
+
+    size_type size() const noexcept { return 1 + tail.size(); }
+
+    iterator begin() noexcept { return iterator{*this, 0}; }
+    const_iterator begin() const noexcept { return const_iterator{*this, 0}; }
+
+    iterator end() noexcept { return iterator{*this, size()}; }
+    const_iterator end() const noexcept { return const_iterator{*this, size()}; }
+
+    const_iterator cbegin() const noexcept { return begin(); }
+    const_iterator cend() const noexcept { return end(); }
+
+    void push_back(basic_json_node&& n) { tail.push_back(std::move(n)); }
+    void push_back(const basic_json_node& n) { tail.push_back(n); }
+
+    /** NOTE: Resizes into @c size equal to @c n+1 value. */
+    void resize(size_type n) { tail.resize(n); }
+
+    const std::string& value() const noexcept { return data; }
+
+ private:
+    std::string data;
+    tail_type tail;
+};
+
+
+template<class T>
+using vector_tail = std::vector<T>;
+
+#ifndef TAIL_CAPACITY
+#define TAIL_CAPACITY 4
+#endif
+
+template<class T>
+using compact_tail = small_tail<T, TAIL_CAPACITY>;
+
+
+using json_node_type = basic_json_node<vector_tail>;
+using compact_json_node_type = basic_json_node<compact_tail>;
+
+
+
+// ---
+
+
+template<class Node>
+class json_tree_builder
+{
+ public:
+    void on_open(std::string_view s) { stack.emplace_back(std::string{s}); }
+
+    void on_scalar(std::string_view s)
+    {
+        if (stack.empty()) stack.emplace_back(std::string{s});
+        else stack.back().push_back(Node{std::string{s}});
+    }
+
+    void on_close()
+    {
+        if (stack.size() == 1) return;
+
+        Node n = std::move(stack.back());
+        stack.pop_back();
+        stack.back().push_back(std::move(n));
+    }
+
+    void on_end() {}
+
+    Node& root() { return stack.front(); }
+
+ private:
+    std::vector<Node> stack;
+};
+
+
+// Minimal recursive-descent JSON reader that emits events into a Builder.
+template<class Builder>
+class json_reader
+{
+ public:
+    json_reader(std::string_view s, Builder& b) : src{s}, builder{b} {}
+
+    bool parse()
+    {
+        if ( ! value()) return false;
+
+        builder.on_end();
+        skip_ws();
+
+        return pos == src.size();
+    }
+
+ private:
+    void skip_ws()
+    {
+        while ((pos < src.size()) && ((src[pos] == ' ') || (src[pos] == '\n') || (src[pos] == '\t') || (src[pos] == '\r'))) ++pos;
+    }
+
+    bool string(std::string_view& out)
+    {
+        const std::size_t begin = ++pos;
+
+        while ((pos < src.size()) && (src[pos] != '"')) pos += (src[pos] == '\\') ? 2 : 1;
+
+        if (pos >= src.size()) return false;
+
+        out = src.substr(begin, pos++ - begin);
+
+        return true;
+    }
+
+    bool container(char close)
+    {
+        builder.on_open(src.substr(pos++, 1));
+        skip_ws();
+
+        if ((pos < src.size()) && (src[pos] == close)) { ++pos; builder.on_close(); return true; }
+
+        for (;;)
+        {
+            if (close == '}')
+            {
+                std::string_view key;
+
+                if ((pos >= src.size()) || (src[pos] != '"') || ! string(key)) return false;
+
+                builder.on_scalar(key);
+                skip_ws();
+
+                if ((pos >= src.size()) || (src[pos++] != ':')) return false;
+            }
+
+            if ( ! value()) return false;
+
+            skip_ws();
+
+            if (pos >= src.size()) return false;
+
+            if (src[pos] == ',') { ++pos; continue; }
+            if (src[pos] == close) { ++pos; builder.on_close(); return true; }
+
+            return false;
+        }
+    }
+
+    bool value()
+    {
+        skip_ws();
+
+        if (pos >= src.size()) return false;
+
+        switch (src[pos])
+        {
+            case '{': return container('}');
+            case '[': return container(']');
+            case '"':
+            {
+                std::string_view s;
+
+                if ( ! string(s)) return false;
+
+                builder.on_scalar(s);
+
+                return true;
+            }
+            default:
+            {
+                const std::size_t begin = pos;
+
+                while ((pos < src.size()) && (std::string_view{",]} \n\t\r"}.find(src[pos]) == std::string_view::npos)) ++pos;
+
+                if (pos == begin) return false;
+
+                builder.on_scalar(src.substr(begin, pos - begin));
+
+                return true;
+            }
+        }
+    }
+
+    std::string_view src;
+    std::size_t pos = 0;
+    Builder& builder;
+};
+
+template<class Builder>
+bool parse(std::string_view s, Builder& b)
+{
+    return json_reader<Builder>{s, b}.parse();
+}
+
+
+
+// ---
+
+
+// Objects store members as key, value pairs of children: {"a":1,"b":2} has four.
+std::string make_records(std::size_t records)
+{
+    std::string s = "[";
+
+    for (std::size_t i = 0; i < records; ++i)
+    {
+        s += (i ? "," : "");
+        s += R"({"id":)" + std::to_string(i)
+           + R"(,"tags":["a","bb","ccc"],"geo":{"lat":52.2297,"lon":21.0122}})";
+    }
+
+    return s + "]";
+}
+
+// Arrays of pairs and triples, the typical fan-out of 0 to 3.
+std::string make_points(std::size_t points)
+{
+    std::string s = "[";
+
+    for (std::size_t i = 0; i < points; ++i)
+    {
+        s += (i ? "," : "");
+        s += "[[" + std::to_string(i) + ",1,2],[3,4],[]]";
+    }
+
+    return s + "]";
+}
+
+
+template<class Node>
+std::size_t count_nodes(const Node& n)
+{
+    std::size_t r = 1;
+
+    std::for_each(std::next(std::cbegin(n)), std::cend(n), [&r](const auto& x) { r += count_nodes(x); });
+
+    return r;
+}
+
+
+struct measurement
+{
+    std::size_t nodes = 0;
+    std::size_t allocations = 0;
+    long peak_rss_kb = 0;
+};
+
+// Runs in a child process, so that peak RSS is not shared between the layouts.
+template<class Node>
+measurement measure(const std::string& payload)
+{
+    int fd[2];
+
+    if (pipe(fd) != 0) std::exit(1);
+
+    std::cout.flush();  // or the child prints it again
+
+    if (fork() == 0)
+    {
+        measurement m;
+
+        auto* builder = new json_tree_builder<Node>;
+        const std::size_t before = allocations;
+
+        if ( ! parse(payload, *builder)) std::exit(1);
+
+        m.allocations = allocations - before;
+        m.nodes = count_nodes(builder->root());
+
+        rusage u{};
+        getrusage(RUSAGE_SELF, &u);
+        m.peak_rss_kb = u.ru_maxrss;
+
+        [[maybe_unused]] auto n = write(fd[1], &m, sizeof(m));
+        std::exit(0);
+    }
+
+    measurement m;
+
+    [[maybe_unused]] auto n = read(fd[0], &m, sizeof(m));
+    wait(nullptr);
+
+    close(fd[0]);
+    close(fd[1]);
+
+    return m;
+}
+
+template<class Node>
+void report(const char* name, const std::string& payload)
+{
+    const measurement m = measure<Node>(payload);
+
+    std::cout << name << ": " << m.nodes << " nodes, " << m.allocations << " allocations ("
+              << static_cast<double>(m.allocations) / m.nodes << " per node), peak RSS " << m.peak_rss_kb / 1024 << " MiB\n";
+}
+
+
+
+int main()
+{
+    {
+        small_tail<std::string, 2> t;
+
+        t.push_back(std::string(32, 'a'));  // not a small string: moving it leaves the source empty
+        t.push_back("b");
+        t.push_back(std::move(t[0]));  // the argument is an element that growth relocates
+
+        std::cout << "push_back of an element on growth: " << std::boolalpha << (t[2] == std::string(32, 'a')) << '\n';
+    }
+
+    {
+        static int live = 0;
+        static int copies = 0;
+
+        struct fragile
+        {
+            fragile() { ++live; }
+            fragile(const fragile&) { if (++copies == 3) throw copies; ++live; }
+            fragile(fragile&&) noexcept { ++live; }
+            ~fragile() { --live; }
+        };
+
+        small_tail<fragile, 4> t;
+
+        t.resize(4);
+
+        try { small_tail<fragile, 4> u{t}; } catch (int) {}
+
+        std::cout << "copy that throws at the third element: " << live << " live, as before: " << (live == 4) << '\n';
+    }
+
+    {
+        const std::size_t before = allocations;
+
+        small_tail<int, 4> t;
+
+        t.resize(0);
+
+        std::cout << "resize(0) of an empty tail: " << allocations - before << " allocations\n";
+    }
+
+    std::cout << "sizeof: " << sizeof(json_node_type) << " vs " << sizeof(compact_json_node_type)
+              << ", tail capacity " << TAIL_CAPACITY << '\n';
+
+    {
+        const std::string payload = make_records(200'000);
+
+        std::cout << "records (" << payload.size() / 1024 / 1024 << " MiB)\n";
+        report<json_node_type>("  std::vector tail", payload);
+        report<compact_json_node_type>("  small_tail      ", payload);
+    }
+
+    {
+        const std::string payload = make_points(200'000);
+
+        std::cout << "points (" << payload.size() / 1024 / 1024 << " MiB)\n";
+        report<json_node_type>("  std::vector tail", payload);
+        report<compact_json_node_type>("  small_tail      ", payload);
+    }
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+push_back of an element on growth: true
+copy that throws at the third element: 4 live, as before: true
+resize(0) of an empty tail: 0 allocations
+sizeof: 56 vs 48, tail capacity 4
+records (14 MiB)
+  std::vector tail: 2800001 nodes, 2000022 allocations (0.714293 per node), peak RSS 205 MiB
+  small_tail      : 2800001 nodes, 800020 allocations (0.285721 per node), peak RSS 179 MiB
+points (4 MiB)
+  std::vector tail: 1800001 nodes, 1600022 allocations (0.888901 per node), peak RSS 131 MiB
+  small_tail      : 1800001 nodes, 600020 allocations (0.333344 per node), peak RSS 133 MiB
+
+g++ -std=c++17 -O2 -Wall -pedantic -pthread -DTAIL_CAPACITY=2 main.cpp && ./a.out
+...
+records (14 MiB)
+  small_tail      : 2800001 nodes, 1400021 allocations (0.500007 per node), peak RSS 179 MiB
+points (4 MiB)
+  small_tail      : 1800001 nodes, 1000021 allocations (0.555567 per node), peak RSS 115 MiB
+*/
@@ -0,0 +1,204 @@
+// see LICENSE on insooth.github.io
+
+
+#include <iostream>
+
+#include <algorithm> // for_each, lower_bound, is_sorted
+#include <atomic> // atomic
+#include <iterator> // reverse_iterator, distance, next
+#include <string>
+#include <thread> // thread, hardware_concurrency
+#include <vector>
+#include <cassert> // assert
+#include <cstddef> // size_t, ptrdiff_t
+#include <type_traits> // enable_if, is_convertible
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/iterator/iterator_categories.hpp>
+
+class json_node_type
+{
+    template<class T>
+    class iter
+      : public boost::iterator_facade<iter<T>, T, boost::random_access_traversal_tag>
+    {
+        struct enabler {};
+        using size_type = typename T::size_type;
+
+     public:
+        // default-constructible and assignable, as required by random access iterators
+        iter() = default;
+
+        explicit iter(T& _n, size_type _i = 0)
+          : n{&_n}, i{_i}
+        {}
+
+        template<class U>
+        iter(const iter<U>& other
+          , std::enable_if_t<std::is_convertible<U*, T*>::value, enabler> = enabler{})
+          : n{other.n}, i{other.i}
+        {}
+
+     private:
+        friend class boost::iterator_core_access;
+
+        template<class> friend class iter;
+
+        template<class U>
+        bool equal(const iter<U>& other) const
+        {
+            return (this->i == other.i) && (this->n == other.n);
+        }
+
+        void increment()
+        {
+            assert(i < n->size());
+            ++i;
+        }
+
+        void decrement()
+        {
+            assert(i > 0);
+            --i;
+        }
+
+        void advance(std::ptrdiff_t d)
+        {
+            assert((static_cast<std::ptrdiff_t>(i) + d >= 0)
+                && (static_cast<std::ptrdiff_t>(i) + d <= static_cast<std::ptrdiff_t>(n->size())));
+            i += d;
+        }
+
+        template<class U>
+        std::ptrdiff_t distance_to(const iter<U>& other) const
+        {
+            assert(this->n == other.n);
+
+            return static_cast<std::ptrdiff_t>(other.i) - static_cast<std::ptrdiff_t>(this->i);
+        }
+
+        T& dereference() const
+        {
+            assert(i < n->size());
+
+            return (i == 0) ? *n : n->tail[i - 1];
+        }
+
+        T* n = nullptr;
+        size_type i = 0;
+    };
+
+ public:
+
+    using tail_type = std::vector<json_node_type>;
+    using size_type = tail_type::size_type;
+    using iterator = iter<json_node_type>;
+    using const_iterator = iter<const json_node_type>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    json_node_type() = default;
+    explicit json_node_type(std::string d) : data{std::move(d)} {}
+
+    size_type size() const noexcept { return 1 + tail.size(); }
+
+    iterator begin() noexcept { return iterator{*this, 0}; }
+    const_iterator begin() const noexcept { return const_iterator{*this, 0}; }
+
+    iterator end() noexcept { return iterator{*this, size()}; }
+    const_iterator end() const noexcept { return const_iterator{*this, size()}; }
+
+    const_iterator cbegin() const noexcept { return const_iterator{*this, 0}; }
+    const_iterator cend() const noexcept { return const_iterator{*this, size()}; }
+
+    reverse_iterator rbegin() noexcept { return reverse_iterator{end()}; }
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator{end()}; }
+
+    reverse_iterator rend() noexcept { return reverse_iterator{begin()}; }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator{begin()}; }
+
+    const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+    const_reverse_iterator crend() const noexcept { return rend(); }
+
+    /** NOTE: Head is not stored together with the tail, so that only tail is contiguous. */
+    json_node_type* tail_data() noexcept { return tail.data(); }
+    const json_node_type* tail_data() const noexcept { return tail.data(); }
+
+    void push_back(json_node_type&& n) { tail.push_back(std::forward<json_node_type>(n)); }
+    void push_back(const json_node_type& n) { tail.push_back(n); }
+
+    /** NOTE: Resizes into @c size equal to @c n+1 value. */
+    void resize(size_type n) { tail.resize(n); }
+
+    const std::string& value() const noexcept { return data; }
+
+ private:
+    std::string data;
+    tail_type tail;
+};
+
+
+// Splits [first, last) into one chunk per worker, possible in O(1) with random access.
+template<class I, class F>
+void parallel_for_each(I first, I last, F f, unsigned workers = std::max(1u, std::thread::hardware_concurrency()))
+{
+    const auto n = std::distance(first, last);
+    const auto chunk = (n + workers - 1) / workers;
+
+    std::vector<std::thread> pool;
+
+    for (auto begin = first; begin != last; )
+    {
+        const auto end = std::next(begin, std::min<decltype(n)>(chunk, std::distance(begin, last)));
+
+        pool.emplace_back([begin, end, &f] { std::for_each(begin, end, f); });
+        begin = end;
+    }
+
+    for (auto& t : pool) t.join();
+}
+
+
+int main()
+{
+    json_node_type n{"a"};
+
+    for (const char* s : {"b", "c", "d", "f", "g"}) n.push_back(json_node_type{s});
+
+    // children, head included, are sorted
+    assert(std::is_sorted(std::cbegin(n), std::cend(n)
+                        , [](const auto& x, const auto& y) { return x.value() < y.value(); }));
+
+    const auto it = std::lower_bound(std::cbegin(n), std::cend(n), std::string{"e"}
+                                   , [](const auto& x, const std::string& v) { return x.value() < v; });
+
+    std::cout << "lower_bound(e): " << it->value() << " at " << (it - std::cbegin(n)) << '\n';
+
+    std::cout << "reversed:";
+    std::for_each(n.crbegin(), n.crend(), [](const auto& x) { std::cout << ' ' << x.value(); });
+    std::cout << '\n';
+
+    std::cout << "n[3]: " << (std::cbegin(n) + 3)->value() << '\n';
+
+    std::atomic<std::size_t> total{0};
+
+    parallel_for_each(std::cbegin(n), std::cend(n)
+                    , [&total](const json_node_type& x) { total += x.value().size(); }
+                    , 2);
+
+    std::cout << "total length: " << total << '\n';
+
+    std::cout << "tail is contiguous: " << std::boolalpha
+              << (&*(std::cbegin(n) + 5) == n.tail_data() + 4) << '\n';
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+lower_bound(e): f at 4
+reversed: g f d c b a
+n[3]: d
+total length: 6
+tail is contiguous: true
+*/
@@ -0,0 +1,979 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout
+
+#include <algorithm>  // for_each
+#include <cassert>  // assert
+#include <chrono>  // steady_clock
+#include <cstddef>  // size_t, ptrdiff_t
+#include <cstdint>  // uint8_t, uint32_t
+#include <cstring>  // memcpy
+#include <iterator>  // reverse_iterator, next
+#include <string>  // string, to_string
+#include <string_view>  // string_view
+#include <type_traits>  // enable_if, is_convertible
+#include <utility>  // move
+#include <vector>  // vector
+
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/iterator/iterator_categories.hpp>
+
+
+
+class json_node_type
+{
+    template<class T>
+    class iter
+      : public boost::iterator_facade<iter<T>, T, boost::random_access_traversal_tag>
+    {
+        struct enabler {};
+        using size_type = typename T::size_type;
+
+     public:
+        // default-constructible and assignable, as required by random access iterators
+        iter() = default;
+
+        explicit iter(T& _n, size_type _i = 0)
+          : n{&_n}, i{_i}
+        {}
+
+        template<class U>
+        iter(const iter<U>& other
+          , std::enable_if_t<std::is_convertible<U*, T*>::value, enabler> = enabler{})
+          : n{other.n}, i{other.i}
+        {}
+
+     private:
+        friend class boost::iterator_core_access;
+
+        template<class> friend class iter;
+
+        template<class U>
+        bool equal(const iter<U>& other) const
+        {
+            return (this->i == other.i) && (this->n == other.n);
+        }
+
+        void increment()
+        {
+            assert(i < n->size());
+            ++i;
+        }
+
+        void decrement()
+        {
+            assert(i > 0);
+            --i;
+        }
+
+        void advance(std::ptrdiff_t d)
+        {
+            assert((static_cast<std::ptrdiff_t>(i) + d >= 0)
+                && (static_cast<std::ptrdiff_t>(i) + d <= static_cast<std::ptrdiff_t>(n->size())));
+            i += d;
+        }
+
+        template<class U>
+        std::ptrdiff_t distance_to(const iter<U>& other) const
+        {
+            assert(this->n == other.n);
+
+            return static_cast<std::ptrdiff_t>(other.i) - static_cast<std::ptrdiff_t>(this->i);
+        }
+
+        T& dereference() const
+        {
+            assert(i < n->size());
+
+            return (i == 0) ? *n : n->tail[i - 1];
+        }
+
+        T* n = nullptr;
+        size_type i = 0;
+    };
+
+ public:
+
+    using tail_type = std::vector<json_node_type>;
+    using size_type = tail_type::size_type;
+    using iterator = iter<json_node_type>;
+    using const_iterator = iter<const json_node_type>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    json_node_type() = default;
+    explicit json_node_type(std::string d) : data{std::move(d)} {}
+
+    size_type size() const noexcept { return 1 + tail.size(); }
+
+    iterator begin() noexcept { return iterator{*this, 0}; }
+    const_iterator begin() const noexcept { return const_iterator{*this, 0}; }
+
+    iterator end() noexcept { return iterator{*this, size()}; }
+    const_iterator end() const noexcept { return const_iterator{*this, size()}; }
+
+    const_iterator cbegin() const noexcept { return const_iterator{*this, 0}; }
+    const_iterator cend() const noexcept { return const_iterator{*this, size()}; }
+
+    reverse_iterator rbegin() noexcept { return reverse_iterator{end()}; }
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator{end()}; }
+
+    reverse_iterator rend() noexcept { return reverse_iterator{begin()}; }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator{begin()}; }
+
+    const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+    const_reverse_iterator crend() const noexcept { return rend(); }
+
+    /** NOTE: Head is not stored together with the tail, so that only tail is contiguous. */
+    json_node_type* tail_data() noexcept { return tail.data(); }
+    const json_node_type* tail_data() const noexcept { return tail.data(); }
+
+    void push_back(json_node_type&& n) { tail.push_back(std::forward<json_node_type>(n)); }
+    void push_back(const json_node_type& n) { tail.push_back(n); }
+
+    /** NOTE: Resizes into @c size equal to @c n+1 value. */
+    void resize(size_type n) { tail.resize(n); }
+
+    /** NOTE: Reserves room for @c n children, that is @c size up to @c n+1 without reallocation. */
+    void reserve(size_type n) { tail.reserve(n); }
+
+    const std::string& value() const noexcept { return data; }
+
+ private:
+    std::string data;
+    tail_type tail;
+};
+// ---
+
+
+// Minimal recursive-descent JSON reader that emits events into a Builder.
+// Strings are reported without quotes and with escapes left as they are.
+template<class Builder>
+class json_reader
+{
+ public:
+    json_reader(std::string_view s, Builder& b) : src{s}, builder{b} {}
+
+    bool parse()
+    {
+        if ( ! value()) return false;
+
+        builder.on_end();
+        skip_ws();
+
+        return pos == src.size();
+    }
+
+ private:
+    void skip_ws()
+    {
+        while ((pos < src.size()) && ((src[pos] == ' ') || (src[pos] == '\n') || (src[pos] == '\t') || (src[pos] == '\r'))) ++pos;
+    }
+
+    bool string(std::string_view& out)
+    {
+        const std::size_t begin = ++pos;  // skip opening quote
+
+        while ((pos < src.size()) && (src[pos] != '"')) pos += (src[pos] == '\\') ? 2 : 1;
+
+        if (pos >= src.size()) return false;
+
+        out = src.substr(begin, pos++ - begin);
+
+        return true;
+    }
+
+    bool container(char close)
+    {
+        builder.on_open(src.substr(pos++, 1));
+        skip_ws();
+
+        if ((pos < src.size()) && (src[pos] == close)) { ++pos; builder.on_close(); return true; }
+
+        for (;;)
+        {
+            if (close == '}')
+            {
+                std::string_view key;
+
+                if ((pos >= src.size()) || (src[pos] != '"') || ! string(key)) return false;
+
+                builder.on_scalar(key);
+                skip_ws();
+
+                if ((pos >= src.size()) || (src[pos++] != ':')) return false;
+            }
+
+            if ( ! value()) return false;
+
+            skip_ws();
+
+            if (pos >= src.size()) return false;
+
+            if (src[pos] == ',') { ++pos; continue; }
+            if (src[pos] == close) { ++pos; builder.on_close(); return true; }
+
+            return false;
+        }
+    }
+
+    bool value()
+    {
+        skip_ws();
+
+        if (pos >= src.size()) return false;
+
+        switch (src[pos])
+        {
+            case '{': return container('}');
+            case '[': return container(']');
+            case '"':
+            {
+                std::string_view s;
+
+                if ( ! string(s)) return false;
+
+                builder.on_scalar(s);
+
+                return true;
+            }
+            default:  // number, true, false, null
+            {
+                const std::size_t begin = pos;
+
+                while ((pos < src.size()) && (std::string_view{",]} \n\t\r"}.find(src[pos]) == std::string_view::npos)) ++pos;
+
+                if (pos == begin) return false;
+
+                builder.on_scalar(src.substr(begin, pos - begin));
+
+                return true;
+            }
+        }
+    }
+
+    std::string_view src;
+    std::size_t pos = 0;
+    Builder& builder;
+};
+
+template<class Builder>
+bool parse(std::string_view s, Builder& b)
+{
+    return json_reader<Builder>{s, b}.parse();
+}
+
+
+
+
+
+// ------------------------------------
+
+
+// Binary format, all integers little endian:
+//
+//   "JNB1" | u32 n | u32 offsets[n + 1] | string bytes | root node
+//
+// Strings are deduplicated, a node refers to its string by index. A node is
+//
+//   varint (index << 1 | has_children) [ | varint count | u32 bytes | children ]
+//
+// where bytes is the length of the children's encoding, so that a subtree
+// is skipped without being read.
+static constexpr std::string_view magic = "JNB1";
+
+class binary_writer
+{
+ public:
+    std::vector<std::uint8_t> encode(const json_node_type& root)
+    {
+        slots.clear();
+        strings.clear();
+        tree.clear();
+        used = 0;
+        total = 0;
+
+        node(root);
+
+        // written once into a buffer of the final size
+        std::vector<std::uint8_t> out(8 + 4 * (strings.size() + 1) + total + used);
+        std::uint8_t* p = out.data();
+
+        std::memcpy(p, magic.data(), magic.size());
+        p = u32(p + magic.size(), static_cast<std::uint32_t>(strings.size()));
+
+        std::uint32_t offset = 0;
+
+        for (std::string_view s : strings) { p = u32(p, offset); offset += static_cast<std::uint32_t>(s.size()); }
+
+        p = u32(p, offset);
+
+        for (std::string_view s : strings) { std::memcpy(p, s.data(), s.size()); p += s.size(); }
+
+        std::memcpy(p, tree.data(), used);
+
+        return out;
+    }
+
+ private:
+    static std::uint8_t* u32(std::uint8_t* p, std::uint32_t v)
+    {
+        for (int k = 0; k < 4; ++k) *p++ = static_cast<std::uint8_t>(v >> (8 * k));
+
+        return p;
+    }
+
+    static std::uint8_t* varint(std::uint8_t* p, std::uint32_t v)
+    {
+        for (; v >= 0x80; v >>= 7) *p++ = static_cast<std::uint8_t>(v | 0x80);
+
+        *p++ = static_cast<std::uint8_t>(v);
+
+        return p;
+    }
+
+    // Up to eight bytes at p, zero padded; shorter words are put together out of
+    // overlapping loads (equal bytes overlap), so that there is no loop per byte.
+    static std::uint64_t word(const char* p, std::size_t n)
+    {
+        const auto byte = [p](std::size_t k) { return std::uint64_t{static_cast<unsigned char>(p[k])} << (8 * k); };
+
+        if (n >= 8)
+        {
+            std::uint64_t w;
+
+            std::memcpy(&w, p, 8);
+
+            return w;
+        }
+
+        if (n >= 4)
+        {
+            std::uint32_t lo, hi;
+
+            std::memcpy(&lo, p, 4);
+            std::memcpy(&hi, p + n - 4, 4);
+
+            return lo | (std::uint64_t{hi} << (8 * (n - 4)));
+        }
+
+        return (n == 0) ? 0 : (byte(0) | byte(n / 2) | byte(n - 1));
+    }
+
+    static std::uint64_t hash(std::string_view s)
+    {
+        std::uint64_t h = 0xcbf29ce484222325 ^ s.size();
+
+        for (std::size_t i = 0; i < s.size(); i += 8)
+        {
+            h = (h ^ word(s.data() + i, s.size() - i)) * 0x9e3779b97f4a7c15;
+            h ^= h >> 32;
+        }
+
+        return h ^ (h >> 29);
+    }
+
+    // Open addressing with linear probing, kept at most half full. A slot keeps
+    // the size and the head of its string: strings up to eight bytes are
+    // compared without leaving the table, longer ones only when these match.
+    std::uint32_t id(std::string_view s)
+    {
+        if (2 * (strings.size() + 1) > slots.size()) grow();
+
+        const std::uint64_t h = hash(s);
+        const std::uint64_t w = word(s.data(), s.size());
+        const auto size = static_cast<std::uint32_t>(s.size());
+        const std::size_t mask = slots.size() - 1;
+
+        for (std::size_t k = h & mask; ; k = (k + 1) & mask)
+        {
+            slot& x = slots[k];
+
+            if (x.index == 0)
+            {
+                strings.push_back(s);
+                total += s.size();
+                x = slot{w, size, static_cast<std::uint32_t>(strings.size())};
+
+                return x.index - 1;
+            }
+
+            if ((x.head == w) && (x.size == size) && ((size <= 8) || (strings[x.index - 1] == s))) return x.index - 1;
+        }
+    }
+
+    void grow()
+    {
+        std::vector<slot> bigger(slots.empty() ? 1024 : 2 * slots.size());
+
+        const std::size_t mask = bigger.size() - 1;
+
+        for (std::uint32_t i = 0; i < strings.size(); ++i)
+        {
+            const std::uint64_t h = hash(strings[i]);
+            std::size_t k = h & mask;
+
+            while (bigger[k].index != 0) k = (k + 1) & mask;
+
+            bigger[k] = slot{word(strings[i].data(), strings[i].size()), static_cast<std::uint32_t>(strings[i].size()), i + 1};
+        }
+
+        slots = std::move(bigger);
+    }
+
+    // tree grows by doubling, used is how much of it is written
+    void node(const json_node_type& n)
+    {
+        constexpr std::size_t longest = 5 + 5 + 4;  // two varints and u32
+
+        if (tree.size() - used < longest) tree.resize(2 * tree.size() + 4096);
+
+        const std::size_t count = n.size() - 1;
+
+        std::uint8_t* p = varint(tree.data() + used, (id(n.value()) << 1) | (count ? 1 : 0));
+
+        if (count == 0) { used = p - tree.data(); return; }
+
+        p = varint(p, static_cast<std::uint32_t>(count));
+
+        const std::size_t at = p - tree.data();  // u32 bytes, patched below
+
+        used = at + 4;
+
+        std::for_each(std::next(n.cbegin()), n.cend(), [this](const json_node_type& c) { node(c); });
+
+        u32(tree.data() + at, static_cast<std::uint32_t>(used - at - 4));
+    }
+
+    struct slot
+    {
+        std::uint64_t head = 0;
+        std::uint32_t size = 0;
+        std::uint32_t index = 0;  // 1 + index in strings, 0 if free
+    };
+
+    std::vector<slot> slots;
+    std::vector<std::string_view> strings;  // views into the values of the json_node_type being encoded
+    std::size_t total = 0;
+    std::vector<std::uint8_t> tree;
+    std::size_t used = 0;
+};
+
+
+
+// ---
+
+
+// Zero-copy view of an encoded buffer (which must outlive it): nothing is
+// decoded up front, strings are views into the buffer.
+class binary_document
+{
+    struct header
+    {
+        std::uint32_t id;
+        std::uint32_t count;  // children
+        std::uint32_t bytes;  // encoding of the children
+        const std::uint8_t* children;
+        const std::uint8_t* next;  // sibling
+    };
+
+ public:
+
+    // Deeper buffers are refused: checking recurses once per level.
+    static constexpr std::uint32_t max_depth = 1024;
+
+    // Handle with the forward traversal interface of json_node_type:
+    // element 0 is the node itself, elements 1..n are its children.
+    class binary_node
+    {
+        template<class T>
+        class iter
+          : public boost::iterator_facade<iter<T>, T, boost::forward_traversal_tag, T>
+        {
+         public:
+            iter(T _n, const std::uint8_t* _at) : n{_n}, at{_at} {}
+
+         private:
+            friend class boost::iterator_core_access;
+
+            bool equal(const iter& other) const { return at == other.at; }
+
+            void increment() { at = (at == n.at) ? n.h.children : n.doc->read(at).next; }
+
+            T dereference() const { return (at == n.at) ? n : T{n.doc, at}; }
+
+            T n;
+            const std::uint8_t* at;
+        };
+
+     public:
+
+        using size_type = std::uint32_t;
+        using iterator = iter<binary_node>;
+        using const_iterator = iter<binary_node>;
+
+        binary_node(const binary_document* d, const std::uint8_t* p) : doc{d}, at{p}, h{d->read(p)} {}
+
+        size_type size() const noexcept { return 1 + h.count; }
+
+        iterator begin() const noexcept { return iterator{*this, at}; }
+        iterator end() const noexcept { return iterator{*this, h.children + h.bytes}; }
+
+        const_iterator cbegin() const noexcept { return begin(); }
+        const_iterator cend() const noexcept { return end(); }
+
+        std::string_view value() const noexcept { return doc->string(h.id); }
+
+     private:
+        const binary_document* doc;
+        const std::uint8_t* at;
+        header h;
+    };
+
+    // false if the buffer is not a well-formed encoding
+    bool open(const std::uint8_t* p, std::size_t size)
+    {
+        last = p + size;
+
+        if ((size < 8) || (std::memcmp(p, magic.data(), magic.size()) != 0)) return false;
+
+        count = u32(p + 4);
+
+        if (count >= (size - 8) / 4) return false;  // offsets do not fit
+
+        offsets = p + 8;
+        strings = offsets + 4 * (count + 1);
+
+        for (std::uint32_t k = 0; k < count; ++k)
+        {
+            if (u32(offsets + 4 * k) > u32(offsets + 4 * (k + 1))) return false;
+        }
+
+        if (u32(offsets + 4 * count) >= static_cast<std::size_t>(last - strings)) return false;  // no room for the root
+
+        tree = strings + u32(offsets + 4 * count);
+
+        return valid(tree, last, max_depth) == last;
+    }
+
+    binary_node root() const { return binary_node{this, tree}; }
+
+ private:
+    static std::uint32_t u32(const std::uint8_t* p)
+    {
+        std::uint32_t v = 0;
+
+        std::memcpy(&v, p, 4);  // little endian hosts only
+
+        return v;
+    }
+
+    // nullptr on overrun
+    static const std::uint8_t* varint(const std::uint8_t* p, const std::uint8_t* end, std::uint32_t& v)
+    {
+        v = 0;
+
+        for (unsigned shift = 0; (p != end) && (shift < 35); shift += 7)
+        {
+            const std::uint8_t b = *p++;
+
+            v |= std::uint32_t{b & 0x7fu} << shift;
+
+            if ((b & 0x80) == 0) return p;
+        }
+
+        return nullptr;
+    }
+
+    // Checked once in open(), thus read() does not check. levels is the
+    // nesting still allowed, including the node at p.
+    const std::uint8_t* valid(const std::uint8_t* p, const std::uint8_t* end, std::uint32_t levels) const
+    {
+        std::uint32_t tag = 0, n = 0;
+
+        if (levels == 0) return nullptr;
+
+        if ( ! (p = varint(p, end, tag)) || ((tag >> 1) >= count)) return nullptr;
+
+        if ((tag & 1) == 0) return p;
+
+        if ( ! (p = varint(p, end, n)) || (n == 0) || ((end - p) < 4)) return nullptr;
+
+        const std::uint32_t bytes = u32(p);
+
+        p += 4;
+
+        if (bytes > static_cast<std::size_t>(end - p)) return nullptr;
+
+        const std::uint8_t* const stop = p + bytes;
+
+        for (; n > 0; --n)
+        {
+            if ( ! (p = valid(p, stop, levels - 1))) return nullptr;
+        }
+
+        return (p == stop) ? p : nullptr;
+    }
+
+    header read(const std::uint8_t* p) const
+    {
+        header h{};
+        std::uint32_t tag = 0;
+
+        p = varint(p, last, tag);
+        h.id = tag >> 1;
+
+        if (tag & 1)
+        {
+            p = varint(p, last, h.count);
+            h.bytes = u32(p);
+            p += 4;
+        }
+
+        h.children = p;
+        h.next = p + h.bytes;
+
+        return h;
+    }
+
+    std::string_view string(std::uint32_t id) const noexcept
+    {
+        const std::uint32_t b = u32(offsets + 4 * id);
+
+        return {reinterpret_cast<const char*>(strings + b), u32(offsets + 4 * (id + 1)) - b};
+    }
+
+    const std::uint8_t* last = nullptr;
+    std::uint32_t count = 0;
+    const std::uint8_t* offsets = nullptr;
+    const std::uint8_t* strings = nullptr;
+    const std::uint8_t* tree = nullptr;
+};
+
+
+
+// ---
+
+
+// Text of a JSON string without its escapes; s is what is between the quotes.
+std::string unescape(std::string_view s)
+{
+    if (s.find('\\') == std::string_view::npos) return std::string{s};
+
+    std::string r;
+
+    r.reserve(s.size());
+
+    const auto hex = [&s](std::size_t at)
+    {
+        std::uint32_t v = 0;
+
+        for (std::size_t k = at; (k < at + 4) && (k < s.size()); ++k)
+        {
+            const char c = s[k];
+
+            v = (v << 4) | static_cast<std::uint32_t>((c <= '9') ? (c - '0') : ((c | 0x20) - 'a' + 10));
+        }
+
+        return v;
+    };
+
+    for (std::size_t i = 0; i < s.size(); ++i)
+    {
+        if ((s[i] != '\\') || (i + 1 == s.size())) { r += s[i]; continue; }
+
+        switch (const char c = s[++i])
+        {
+            case 'b': r += '\b'; break;
+            case 'f': r += '\f'; break;
+            case 'n': r += '\n'; break;
+            case 'r': r += '\r'; break;
+            case 't': r += '\t'; break;
+            case 'u':
+            {
+                std::uint32_t u = hex(i + 1);
+
+                i += 4;
+
+                if ((u >= 0xd800) && (u < 0xdc00) && (i + 6 < s.size()) && (s[i + 1] == '\\') && (s[i + 2] == 'u'))  // surrogate pair
+                {
+                    u = 0x10000 + ((u - 0xd800) << 10) + (hex(i + 3) - 0xdc00);
+                    i += 6;
+                }
+
+                // UTF-8
+                if (u < 0x80) r += static_cast<char>(u);
+                else if (u < 0x800) { r += static_cast<char>(0xc0 | (u >> 6)); r += static_cast<char>(0x80 | (u & 0x3f)); }
+                else if (u < 0x10000) { r += static_cast<char>(0xe0 | (u >> 12)); r += static_cast<char>(0x80 | ((u >> 6) & 0x3f)); r += static_cast<char>(0x80 | (u & 0x3f)); }
+                else { r += static_cast<char>(0xf0 | (u >> 18)); r += static_cast<char>(0x80 | ((u >> 12) & 0x3f)); r += static_cast<char>(0x80 | ((u >> 6) & 0x3f)); r += static_cast<char>(0x80 | (u & 0x3f)); }
+
+                break;
+            }
+            default: r += c;  // '"', '\\', '/'
+        }
+    }
+
+    return r;
+}
+
+
+// Values in the tree are text: strings without their escapes.
+class json_tree_builder
+{
+ public:
+    void on_open(std::string_view s) { stack.emplace_back(std::string{s}); }
+
+    void on_scalar(std::string_view s)
+    {
+        if (stack.empty()) stack.emplace_back(unescape(s));
+        else stack.back().push_back(json_node_type{unescape(s)});
+    }
+
+    void on_close()
+    {
+        if (stack.size() == 1) return;
+
+        json_node_type n = std::move(stack.back());
+        stack.pop_back();
+        stack.back().push_back(std::move(n));
+    }
+
+    void on_end() {}
+
+    json_node_type& root() { return stack.front(); }
+
+ private:
+    std::vector<json_node_type> stack;
+};
+
+
+// JSON string of s, quotes included.
+void escape(std::string_view s, std::string& out)
+{
+    static constexpr char digits[] = "0123456789abcdef";
+
+    out += '"';
+
+    std::size_t plain = 0;  // start of the run of characters copied as they are
+
+    for (std::size_t i = 0; i < s.size(); ++i)
+    {
+        const auto c = static_cast<unsigned char>(s[i]);
+
+        if ((c >= 0x20) && (c != '"') && (c != '\\')) continue;
+
+        out.append(s.data() + plain, i - plain);
+        plain = i + 1;
+
+        switch (c)
+        {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default: out += "\\u00"; out += digits[c >> 4]; out += digits[c & 0xf];
+        }
+    }
+
+    out.append(s.data() + plain, s.size() - plain);
+    out += '"';
+}
+
+// Text JSON out of a tree; scalars are written as strings, that is what the tree keeps.
+void to_text(const json_node_type& n, std::string& out)
+{
+    const std::string& v = n.value();
+
+    if ((v != "{") && (v != "["))
+    {
+        escape(v, out);
+
+        return;
+    }
+
+    out += v;
+
+    std::size_t i = 0;
+
+    std::for_each(std::next(n.cbegin()), n.cend(), [&out, &v, &i](const json_node_type& c)
+    {
+        if (i > 0) out += ((v == "{") && (i % 2 == 1)) ? ':' : ',';  // members are key, value pairs
+
+        to_text(c, out);
+        ++i;
+    });
+
+    out += (v == "{") ? '}' : ']';
+}
+
+
+
+// ---
+
+
+template<class Node>
+std::size_t total_length(const Node& n)
+{
+    std::size_t r = 0;
+    bool head = true;
+
+    std::for_each(std::cbegin(n), std::cend(n), [&r, &head](const auto& x)
+    {
+        if (head) { r += x.value().size(); head = false; }
+        else r += total_length(x);
+    });
+
+    return r;
+}
+
+// Decoding into a tree, for the comparison with text.
+template<class Node>
+json_node_type materialise(const Node& n)
+{
+    json_node_type r{std::string{n.value()}};
+
+    r.reserve(n.size() - 1);
+
+    std::for_each(std::next(std::cbegin(n)), std::cend(n), [&r](const auto& c) { r.push_back(materialise(c)); });
+
+    return r;
+}
+
+std::string make_payload(std::size_t records)
+{
+    std::string s = "[";
+
+    for (std::size_t i = 0; i < records; ++i)
+    {
+        s += (i ? "," : "");
+        s += R"({"id":")" + std::to_string(i)
+           + R"(","name":"user)" + std::to_string(i % 1000)
+           + R"(","active":"true","tags":["a","bb","ccc"],"geo":{"lat":"52.2297","lon":"21.0122"}})";
+    }
+
+    return s + "]";
+}
+
+template<class F>
+double ms(F f)
+{
+    double best = 1e300;
+
+    for (int r = 0; r < 5; ++r)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        f();
+
+        best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    return best;
+}
+
+
+
+int main()
+{
+    json_tree_builder b;
+
+    if ( ! parse(make_payload(200'000), b)) return 1;
+
+    const json_node_type& tree = b.root();
+    const std::size_t expected = total_length(tree);
+
+    std::string text;
+    std::vector<std::uint8_t> wire;
+
+    const double text_encode = ms([&] { text.clear(); to_text(tree, text); });
+    const double text_decode = ms([&]
+    {
+        json_tree_builder t;
+
+        if ( ! parse(text, t) || (total_length(t.root()) != expected)) std::cout << "text: WRONG\n";
+    });
+
+    const double binary_encode = ms([&] { wire = binary_writer{}.encode(tree); });
+    const double binary_walk = ms([&]
+    {
+        binary_document d;
+
+        if ( ! d.open(wire.data(), wire.size()) || (total_length(d.root()) != expected)) std::cout << "binary: WRONG\n";
+    });
+    const double binary_decode = ms([&]
+    {
+        binary_document d;
+
+        if ( ! d.open(wire.data(), wire.size()) || (total_length(materialise(d.root())) != expected)) std::cout << "binary: WRONG\n";
+    });
+
+    std::cout << "text:   " << text.size() / 1024 << " KiB, encode " << text_encode << " ms, parse into tree + walk " << text_decode << " ms\n";
+    std::cout << "binary: " << wire.size() / 1024 << " KiB, encode " << binary_encode << " ms, open + walk " << binary_walk
+              << " ms, decode into tree + walk " << binary_decode << " ms\n";
+    std::cout << "round trip speed-up: " << (text_encode + text_decode) / (binary_encode + binary_walk) << " (zero-copy), "
+              << (text_encode + text_decode) / (binary_encode + binary_decode) << " (into tree)\n";
+
+    {
+        binary_document d;
+        std::vector<std::uint8_t> w = binary_writer{}.encode(tree);
+
+        std::cout << "open: " << std::boolalpha << d.open(w.data(), w.size());
+
+        w.resize(w.size() - 1);
+        std::cout << ", truncated: " << d.open(w.data(), w.size());
+
+        w = binary_writer{}.encode(tree);
+        w[8] = 0xff;  // first offset beyond the second one
+        std::cout << ", corrupted: " << d.open(w.data(), w.size());
+
+        const auto chain = [](std::uint32_t depth)  // depth nodes, each the only child of the previous one
+        {
+            json_node_type n{"x"};
+
+            for (std::uint32_t k = 1; k < depth; ++k)
+            {
+                json_node_type parent{"x"};
+
+                parent.push_back(std::move(n));
+                n = std::move(parent);
+            }
+
+            return binary_writer{}.encode(n);
+        };
+
+        w = chain(binary_document::max_depth);
+        std::cout << ", " << binary_document::max_depth << " deep: " << d.open(w.data(), w.size());
+
+        w = chain(binary_document::max_depth + 1);
+        std::cout << ", " << binary_document::max_depth + 1 << " deep: " << d.open(w.data(), w.size()) << '\n';
+    }
+
+    {
+        // escapes are decoded into the tree and written back by to_text
+        const std::string_view escaped = R"(["q\"b\\s\/l\n\u00e9\ud83d\ude00\u0001"])";
+
+        json_tree_builder t, u;
+        std::string again;
+
+        const bool read = parse(escaped, t);
+        const std::string& value = std::next(t.root().cbegin())->value();
+
+        to_text(t.root(), again);
+
+        std::cout << "escapes: " << (read && (value == "q\"b\\s/l\n\xc3\xa9\xf0\x9f\x98\x80\x01") && (again == "[\"q\\\"b\\\\s/l\\n\xc3\xa9\xf0\x9f\x98\x80\\u0001\"]"))
+                  << ", round trip " << (parse(again, u) && (std::next(u.root().cbegin())->value() == value)) << '\n';
+    }
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+text:   21940 KiB, encode 178.602 ms, parse into tree + walk 585.691 ms
+binary: 8874 KiB, encode 144.068 ms, open + walk 85.1124 ms, decode into tree + walk 328.6 ms
+round trip speed-up: 3.3349 (zero-copy), 1.61698 (into tree)
+open: true, truncated: false, corrupted: false, 1024 deep: true, 1025 deep: false
+escapes: true, round trip true
+*/
@@ -0,0 +1,407 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout, cerr
+
+#include <algorithm>  // min
+#include <array>  // array
+#include <atomic>  // atomic
+#include <chrono>  // steady_clock
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+#include <cstdlib>  // abort
+#include <limits>  // numeric_limits
+#include <memory>  // shared_ptr, make_shared, atomic_load, atomic_store, unique_ptr, make_unique
+#include <mutex>  // mutex, lock_guard
+#include <shared_mutex>  // shared_mutex, shared_lock
+#include <thread>  // thread, yield, sleep_for
+#include <utility>  // move
+#include <vector>  // vector
+
+
+
+[[noreturn]] void fatal(const char* what)
+{
+    std::cerr << "fatal: " << what << std::endl;
+    std::abort();
+}
+
+
+// Grace periods for any number of rcu_cells. Every reading thread holds an
+// rcu_domain::reader: a slot of its own cache line where it reports the epoch
+// it has seen when it held no reference to any version (quiescent state).
+// A version retired in epoch e is disposed once every online reader has
+// reported an epoch past e. Readers themselves never write anything shared.
+class rcu_domain
+{
+    static constexpr std::uint64_t offline = std::numeric_limits<std::uint64_t>::max();
+
+    struct alignas(64) slot
+    {
+        std::atomic<std::uint64_t> seen{offline};
+        std::atomic<bool> taken{false};
+    };
+
+    struct retired
+    {
+        const void* p;
+        void (*dispose)(const void*);
+        std::uint64_t epoch;
+    };
+
+public:
+
+    static constexpr std::size_t max_readers = 64;
+
+    class reader
+    {
+    public:
+
+        explicit reader(rcu_domain& d) : d{d}, s{d.claim()} { online(); }
+
+        reader(const reader&) = delete;
+        reader& operator=(const reader&) = delete;
+
+        ~reader()
+        {
+            offline();
+            s.taken.store(false, std::memory_order_release);
+        }
+
+        // No reference obtained before this call is used after it. The fence
+        // keeps the report from being reordered after the reads that follow.
+        void quiescent() noexcept
+        {
+            s.seen.store(d.epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        // Leaves the domain for a while (e.g. before blocking): writers do not wait for it.
+        void offline() noexcept { s.seen.store(rcu_domain::offline, std::memory_order_release); }
+        void online() noexcept { quiescent(); }
+
+    private:
+
+        rcu_domain& d;
+        slot& s;
+    };
+
+    // Frees versions retired at the time of the call, waiting for readers to
+    // pass a quiescent state. A thread whose reader of this domain is online
+    // must not call it: it would wait for itself forever (go offline() first).
+    void synchronize()
+    {
+        std::lock_guard<std::mutex> lock{writers};
+
+        const std::uint64_t now = epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+
+        while (oldest_seen() < now) std::this_thread::yield();
+
+        reclaim(now);
+    }
+
+    std::size_t pending() const
+    {
+        std::lock_guard<std::mutex> lock{writers};
+
+        return limbo.size();
+    }
+
+    std::size_t disposed() const noexcept { return reclaimed.load(std::memory_order_relaxed); }
+
+    ~rcu_domain()
+    {
+        for (const auto& r : limbo) r.dispose(r.p);
+    }
+
+private:
+
+    template<class T>
+    friend class rcu_cell;
+
+    slot& claim()
+    {
+        for (auto& s : slots)
+        {
+            bool free = false;
+
+            if (s.taken.compare_exchange_strong(free, true, std::memory_order_acquire)) return s;
+        }
+
+        fatal("rcu_domain: too many readers");
+    }
+
+    std::uint64_t oldest_seen() const noexcept
+    {
+        std::uint64_t oldest = offline;
+
+        for (const auto& s : slots) oldest = std::min(oldest, s.seen.load(std::memory_order_seq_cst));
+
+        return oldest;
+    }
+
+    // Writers hold the lock. Every version retired before epoch e and seen past by all readers goes.
+    void reclaim(std::uint64_t e)
+    {
+        std::size_t kept = 0;
+
+        for (const auto& r : limbo)
+        {
+            if (r.epoch < e) r.dispose(r.p);
+            else limbo[kept++] = r;
+        }
+
+        reclaimed.fetch_add(limbo.size() - kept, std::memory_order_relaxed);
+        limbo.resize(kept);
+    }
+
+    // Writers hold the lock. The old version is already unreachable for new readers.
+    void retire(const void* p, void (*dispose)(const void*))
+    {
+        const std::uint64_t e = epoch.fetch_add(1, std::memory_order_seq_cst);
+
+        limbo.push_back({p, dispose, e});
+        reclaim(oldest_seen());
+    }
+
+    std::atomic<std::uint64_t> epoch{1};
+    std::array<slot, max_readers> slots;
+
+    mutable std::mutex writers;
+    std::vector<retired> limbo;
+    std::atomic<std::size_t> reclaimed{0};
+};
+
+
+// The current version of T. Reading is one acquire load; the version read
+// stays valid until the reader reports a quiescent state. Writers copy the
+// current version, modify the copy and publish it; the old one is disposed
+// after a grace period of the domain.
+template<class T>
+class rcu_cell
+{
+public:
+
+    rcu_cell(rcu_domain& d, T initial) : d{d}, current{new T(std::move(initial))} {}
+
+    rcu_cell(const rcu_cell&) = delete;
+    rcu_cell& operator=(const rcu_cell&) = delete;
+
+    ~rcu_cell() { delete current.load(std::memory_order_relaxed); }
+
+    const T* get() const noexcept { return current.load(std::memory_order_acquire); }
+    const T& operator*() const noexcept { return *get(); }
+    const T* operator->() const noexcept { return get(); }
+
+    // Publishes a modified copy of the current version, f modifies the copy.
+    template<class F>
+    void update(F f)
+    {
+        std::lock_guard<std::mutex> lock{d.writers};
+
+        auto next = std::make_unique<T>(*current.load(std::memory_order_relaxed));  // freed if f throws
+
+        f(*next);
+
+        const T* old = current.exchange(next.release(), std::memory_order_seq_cst);
+
+        d.retire(old, [](const void* p) { delete static_cast<const T*>(p); });
+    }
+
+private:
+
+    rcu_domain& d;
+    std::atomic<T*> current;
+};
+
+// ------------------------------------
+
+constexpr std::size_t routes_count = 256;
+
+struct routes
+{
+    std::uint64_t version = 0;
+    std::array<std::uint64_t, routes_count> next_hop{};  // next_hop[i] == version + i
+};
+
+void bump(routes& r)
+{
+    ++r.version;
+
+    for (std::size_t i = 0; i < routes_count; ++i) r.next_hop[i] = r.version + i;
+}
+
+// true if the version read is whole, what a freed or torn one would not be
+bool whole(const routes& r, std::size_t i) { return r.next_hop[i] == r.version + i; }
+
+// ---
+
+constexpr std::size_t readers = 3;
+constexpr std::size_t lookups = 1 << 22;  // per reader
+constexpr std::size_t batch = 64;  // lookups between quiescent states
+
+std::uint64_t next(std::uint64_t& x)
+{
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+
+    return x;
+}
+
+struct run
+{
+    double ms;
+    std::size_t updates;
+    bool whole;
+};
+
+// Readers look up random routes, one writer updates them every 100 us until the readers are done.
+template<class Read, class Write>
+run race(Read read, Write write)
+{
+    std::atomic<std::size_t> done{0};
+    std::atomic<bool> broken{false};
+    std::size_t updates = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::thread writer{[&]
+    {
+        while (done.load(std::memory_order_acquire) < readers)
+        {
+            write();
+            ++updates;
+            std::this_thread::sleep_for(std::chrono::microseconds{100});
+        }
+    }};
+
+    std::vector<std::thread> lookup;
+
+    for (std::size_t t = 0; t < readers; ++t)
+    {
+        lookup.emplace_back([&, t]
+        {
+            std::uint64_t x = 88172645463325252ull + t;
+
+            if ( ! read(x)) broken.store(true);
+
+            done.fetch_add(1, std::memory_order_release);
+        });
+    }
+
+    for (auto& l : lookup) l.join();
+
+    writer.join();
+
+    return {std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), updates, ! broken.load()};
+}
+
+std::ostream& operator<<(std::ostream& os, const run& r)
+{
+    return os << r.ms << " ms, " << r.updates << " updates, all versions whole " << std::boolalpha << r.whole;
+}
+
+
+int main()
+{
+    {
+        rcu_domain d;
+        rcu_cell<routes> table{d, routes{}};
+
+        table.update(bump);
+
+        const auto result = race(
+            [&](std::uint64_t& x)
+            {
+                rcu_domain::reader self{d};
+                bool ok = true;
+
+                for (std::size_t i = 0; i < lookups; ++i)
+                {
+                    if (i % batch == 0) self.quiescent();
+
+                    ok &= whole(*table, next(x) % routes_count);
+                }
+
+                return ok;
+            },
+            [&] { table.update(bump); });
+
+        const std::size_t on_the_fly = d.disposed();
+
+        d.synchronize();
+
+        std::cout << "rcu_cell:                      " << result << ", disposed " << on_the_fly << " on the fly, " << d.disposed() - on_the_fly << " on synchronize, pending " << d.pending() << '\n';
+    }
+
+    {
+        std::shared_mutex m;
+        routes table;
+
+        bump(table);
+
+        const auto result = race(
+            [&](std::uint64_t& x)
+            {
+                bool ok = true;
+
+                for (std::size_t i = 0; i < lookups; ++i)
+                {
+                    std::shared_lock<std::shared_mutex> lock{m};
+
+                    ok &= whole(table, next(x) % routes_count);
+                }
+
+                return ok;
+            },
+            [&]
+            {
+                std::lock_guard<std::shared_mutex> lock{m};
+
+                bump(table);
+            });
+
+        std::cout << "std::shared_mutex:             " << result << '\n';
+    }
+
+    {
+        auto table = std::make_shared<const routes>();
+
+        const auto result = race(
+            [&](std::uint64_t& x)
+            {
+                bool ok = true;
+
+                for (std::size_t i = 0; i < lookups; ++i)
+                {
+                    const auto version = std::atomic_load(&table);
+
+                    ok &= whole(*version, next(x) % routes_count);
+                }
+
+                return ok;
+            },
+            [&]
+            {
+                auto copy = std::make_shared<routes>(*std::atomic_load(&table));
+
+                bump(*copy);
+                std::atomic_store(&table, std::shared_ptr<const routes>{std::move(copy)});
+            });
+
+        std::cout << "std::atomic_load(shared_ptr):  " << result << '\n';
+    }
+
+    std::cout << readers << " readers x " << lookups << " lookups, " << std::thread::hardware_concurrency() << " cores\n";
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+rcu_cell:                      41.23 ms, 183 updates, all versions whole true, disposed 183 on the fly, 1 on synchronize, pending 0
+std::shared_mutex:             341.585 ms, 23 updates, all versions whole true
+std::atomic_load(shared_ptr):  645.064 ms, 1279 updates, all versions whole true
+3 readers x 4194304 lookups, 1 cores
+*/
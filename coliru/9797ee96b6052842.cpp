@@ -0,0 +1,483 @@
+// see LICENSE on insooth.github.io
+
+
+#include <array>  // array
+#include <atomic>  // atomic, memory_order_*
+#include <chrono>  // steady_clock
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t, uint64_t
+#include <functional>  // hash
+#include <tuple> // tuple, tuple_size, get, tuple_element
+#include <thread>  // thread
+#include <type_traits>  // true_type, false_type, is_same, common_type, is_empty, enable_if
+#include <utility> // index_sequence, forward
+#include <vector>  // vector
+
+#include <iostream>
+#include <string>
+
+
+
+
+template<class Tuple, template<class> class Predicate>
+class find_in_if
+{
+    template<
+        class T  // actual type
+      , template<class> class P  // predicate
+      , std::size_t I  // index within a tuple
+      >
+    struct box
+    {
+        using                        type  = T;
+        static constexpr std::size_t index = I;
+        static constexpr bool        value = P<T>::value;  // disjunction uses this
+    };
+
+    template<class, class = void>
+    struct find_in_if_impl;
+
+    template<std::size_t... Is, class _>
+    struct find_in_if_impl<std::index_sequence<Is...>, _>
+    {
+        using type =
+            std::disjunction<
+                box<std::tuple_element_t<Is, Tuple>, Predicate, Is>...
+              , box<struct not_found, Predicate, std::tuple_size_v<Tuple>>  // fallback
+            >;
+    };
+
+ public:
+
+    using type =
+        typename find_in_if_impl<
+            std::make_index_sequence<std::tuple_size_v<Tuple>>
+        >::type;
+};
+
+template<class Tuple, template<class> class Predicate>
+using find_in_if_t = typename find_in_if<Tuple, Predicate>::type;
+
+
+
+
+// ------------------------------------
+
+
+// box<Tag, F> is a type constructor
+// we want to partially apply
+template<class Tag, class F>
+struct box : F
+{
+    using F::operator();
+
+    using type     = F;
+    using tag_type = Tag;
+};
+
+template<class Tag, class F>
+constexpr auto boxify(F f)
+{
+    return box<Tag, F>{f};
+}
+
+// Partially apply tag_matcher than looks for box<Tag, F>.
+template<class Tag>
+class matcher
+{
+    template<class T, class B>
+    struct tag_matcher;
+
+    template<class T, class U, class F>
+    struct tag_matcher<T, box<U, F>> : std::false_type {};
+
+    template<class T, class F>
+    struct tag_matcher<T, box<T, F>> : std::true_type {};
+
+ public:
+
+    template<class Box>
+    using apply = tag_matcher<Tag, Box>;
+};
+
+// Get F from box<Tag, F> stored in Fs tuple.
+template<class Tag, class Fs>
+constexpr auto unbox(Fs&& fs)
+{
+    using items = std::remove_reference_t<Fs>;
+    using found = find_in_if_t<items, matcher<Tag>::template apply>;
+
+    if constexpr (found::index < std::tuple_size_v<items>)
+    {
+        return std::get<found::index>(std::forward<Fs>(fs));
+    }
+    else
+    {
+        return [](auto&&...) -> typename found::type {};  // not_found
+    }
+}
+
+
+template<class T, class U>
+struct is_equiv : std::false_type {};
+
+template<class R, template<class> class C1, class C2, class... Ts, class... As>
+struct is_equiv<R (C1<Ts...>::*)(As...), R (C2::*)(As...)> : std::true_type {};
+
+template<class T>
+struct drop_const : std::common_type<T> {};
+
+template<class R, class C, class... As>
+struct drop_const<R (C::*)(As...) const> : std::common_type<R (C::*)(As...)> {};
+
+template<class Tag, class F>
+using is_delegate =
+    is_equiv<typename Tag::type
+           , typename drop_const<decltype(&F::operator())>::type
+           >;
+
+
+
+// ------------------------------------
+
+
+// Partially apply is_same to look for a bare Tag.
+template<class T>
+struct same_as
+{
+    template<class U>
+    using apply = std::is_same<T, U>;
+};
+
+
+// Digest of the call arguments, 0 for arguments that are not hashable.
+template<class A, class = void>
+struct digest_of
+{
+    static constexpr std::uint64_t apply(const A&) noexcept { return 0; }
+};
+
+template<class A>
+struct digest_of<A, std::void_t<decltype(std::hash<A>{}(std::declval<const A&>()))>>
+{
+    static std::uint64_t apply(const A& a) noexcept { return std::hash<A>{}(a); }
+};
+
+template<class... As>
+std::uint64_t digest(const As&... as) noexcept
+{
+    std::uint64_t d = 0xcbf29ce484222325;  // FNV-1a offset basis
+
+    ((d = (d ^ digest_of<As>::apply(as)) * 0x100000001b3), ...);
+
+    return d;
+}
+
+
+// Fixed-size ring of the recent calls with per-tag call counters.
+// Writers never block: the oldest entries are overwritten, each slot
+// carries the sequence number of its last write to detect torn reads.
+// A slot is claimed before it is written, so that a writer N calls ahead
+// cannot write it at the same time: the one that finds it claimed, or
+// already written by a later call, drops its entry (but still counts).
+template<std::size_t N, class... Tags>
+class call_log
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+
+    static constexpr std::uint64_t writing = std::uint64_t{1} << 63;
+
+    struct slot
+    {
+        std::atomic<std::uint64_t> seq{0};  // 0 -- never written, writing | s -- being written by call s
+        std::atomic<std::uint32_t> tag{0};
+        std::atomic<std::uint64_t> timestamp{0};
+        std::atomic<std::uint64_t> digest{0};
+    };
+
+ public:
+
+    struct entry
+    {
+        std::uint32_t tag;
+        std::uint64_t timestamp;
+        std::uint64_t digest;
+    };
+
+    template<class Tag>
+    static constexpr std::uint32_t tag_id()
+    {
+        using found = find_in_if_t<std::tuple<Tags...>, same_as<Tag>::template apply>;
+
+        static_assert(found::index < sizeof...(Tags), "Tag not registered in call_log");
+
+        return found::index;
+    }
+
+    template<class Tag>
+    void push(std::uint64_t d) noexcept
+    {
+        constexpr auto id = tag_id<Tag>();
+
+        const std::uint64_t s = 1 + head.fetch_add(1, std::memory_order_relaxed);
+        slot& e = slots[(s - 1) & (N - 1)];
+
+        counters[id].fetch_add(1, std::memory_order_relaxed);
+
+        std::uint64_t seen = e.seq.load(std::memory_order_relaxed);
+
+        do
+        {
+            if ((seen & writing) || (seen >= s)) return;  // lapped
+        }
+        while ( ! e.seq.compare_exchange_weak(seen, writing | s, std::memory_order_relaxed));
+
+        std::atomic_thread_fence(std::memory_order_release);
+
+        e.tag.store(id, std::memory_order_relaxed);
+        e.timestamp.store(
+            std::chrono::steady_clock::now().time_since_epoch().count()
+          , std::memory_order_relaxed);
+        e.digest.store(d, std::memory_order_relaxed);
+
+        e.seq.store(s, std::memory_order_release);
+    }
+
+    template<class Tag>
+    std::size_t count() const noexcept
+    {
+        return counters[tag_id<Tag>()].load(std::memory_order_relaxed);
+    }
+
+    // Recent calls, oldest first. Not meant for the measured path.
+    std::vector<entry> snapshot() const
+    {
+        const std::uint64_t last = head.load(std::memory_order_acquire);
+        const std::uint64_t first = (last > N) ? (last - N) : 0;
+
+        std::vector<entry> r;
+        r.reserve(last - first);
+
+        for (std::uint64_t s = first + 1; s <= last; ++s)
+        {
+            const slot& e = slots[(s - 1) & (N - 1)];
+
+            if (e.seq.load(std::memory_order_acquire) != s) continue;  // overwritten or torn
+
+            entry x{e.tag.load(std::memory_order_relaxed)
+                  , e.timestamp.load(std::memory_order_relaxed)
+                  , e.digest.load(std::memory_order_relaxed)};
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if (e.seq.load(std::memory_order_relaxed) == s) r.push_back(x);
+        }
+
+        return r;
+    }
+
+ private:
+    std::atomic<std::uint64_t> head{0};
+    std::array<slot, N> slots{};
+    std::array<std::atomic<std::size_t>, sizeof...(Tags)> counters{};
+};
+
+
+// Recording policies for M.
+
+struct no_recording
+{
+    static constexpr bool enabled = false;
+};
+
+template<class Log>
+struct recording
+{
+    static constexpr bool enabled = true;
+
+    template<class Tag, class... As>
+    void record(const As&... as) const noexcept
+    {
+        log->template push<Tag>(digest(as...));
+    }
+
+    Log* log;
+};
+
+template<class Log>
+constexpr auto record_into(Log& log) { return recording<Log>{&log}; }
+
+
+
+// --------------------
+
+
+
+template<class Injected>
+struct Testable
+{
+
+    void foo() { obj.foo(); }
+
+    int bar(std::string s)
+    {
+        obj.foo();
+
+        return obj.bar(s);
+    }
+
+    Injected obj;
+};
+
+
+struct Foo : std::common_type<void (Testable<int>::*)()> {};
+struct Bar : std::common_type<int (Testable<int>::*)(std::string)> {};
+
+
+template<class R, class... Fs>
+struct M : R  // R is empty for no_recording
+{
+    // R is not deducible here, deduction guides below select it
+    M(std::common_type_t<R> r, Fs... fs) : R{r}, fs{fs...}
+    {
+        static_assert(std::conjunction_v<
+            is_delegate<typename Fs::tag_type, typename Fs::type>...
+            >, "Tag sig must match sig of mocked mem fn");
+    }
+
+    // Only a policy that records nothing can be made out of nothing.
+    template<class Q = R, class = std::enable_if_t< ! Q::enabled>>
+    M(Fs... fs) : M{R{}, fs...} {}
+
+    // iface
+    void foo() { call<Foo>(); }
+    int bar(std::string s) { return call<Bar>(s); }
+
+    std::tuple<Fs...> fs;
+
+ private:
+
+    template<class Tag, class... As>
+    decltype(auto) call(As&&... as)
+    {
+        if constexpr (R::enabled)
+        {
+            R::template record<Tag>(as...);
+        }
+
+        return unbox<Tag>(fs)(std::forward<As>(as)...);
+    }
+};
+
+template<class... Fs>
+M(Fs...) -> M<no_recording, Fs...>;
+
+template<class Log, class... Fs>
+M(recording<Log>, Fs...) -> M<recording<Log>, Fs...>;
+
+
+static_assert(std::is_empty_v<no_recording>);
+
+
+
+int main()
+{
+    using namespace std::literals;
+
+    auto foo = boxify<Foo>([] { std::cout << "foo" << std::endl; });
+    auto bar = boxify<Bar>([](std::string s) -> int { std::cout << "bar " << s << std::endl; return 0; });
+
+
+    // correctness and performance: nothing recorded
+    M m{foo, bar};
+
+    static_assert(std::is_same_v<decltype(m), M<no_recording, decltype(foo), decltype(bar)>>);
+
+    Testable<decltype(m)> t{m};
+
+    t.foo();
+    t.bar("xxx"s);
+
+
+    // call sequence verification
+    call_log<8, Foo, Bar> log;
+
+    M rm{record_into(log), foo, bar};
+
+    Testable<decltype(rm)> rt{rm};
+
+    rt.foo();
+    rt.bar("xxx"s);
+    rt.bar("yyy"s);
+
+    std::cout << "foo: " << log.count<Foo>() << " bar: " << log.count<Bar>() << '\n';
+
+    for (const auto& e : log.snapshot())
+    {
+        std::cout << (e.tag == log.tag_id<Foo>() ? "Foo" : "Bar")
+                  << ((e.digest == digest("xxx"s)) ? " xxx" : "")
+                  << '\n';
+    }
+
+    // error: no matching function for call, a recording M needs its log
+    // M<recording<call_log<8, Foo, Bar>>, decltype(foo), decltype(bar)> unlogged{foo, bar};
+
+
+    // writers lapping each other: every entry read is whole, Foo with digest 1, Bar with 2
+    {
+        call_log<4, Foo, Bar> ring;
+        std::atomic<bool> stop{false};
+        std::size_t read = 0, torn = 0;
+
+        std::vector<std::thread> writers;
+
+        for (std::size_t w = 0; w < 4; ++w)
+        {
+            writers.emplace_back([&ring, &stop, w]
+            {
+                while ( ! stop.load(std::memory_order_relaxed))
+                {
+                    if (w % 2) ring.push<Bar>(2);
+                    else ring.push<Foo>(1);
+                }
+            });
+        }
+
+        while (read < 100'000)
+        {
+            for (const auto& e : ring.snapshot())
+            {
+                ++read;
+                torn += (e.digest != e.tag + 1);
+            }
+        }
+
+        stop = true;
+
+        for (auto& w : writers) w.join();
+
+        std::cout << "lapped ring: " << torn << " torn entries\n";
+    }
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+foo
+foo
+bar xxx
+foo
+foo
+bar xxx
+foo
+bar yyy
+foo: 3 bar: 2
+Foo
+Foo
+Bar xxx
+Foo
+Bar
+lapped ring: 0 torn entries
+*/
@@ -0,0 +1,707 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout
+
+#include <algorithm>  // for_each, max
+#include <atomic>  // atomic
+#include <cassert>  // assert
+#include <chrono>  // steady_clock
+#include <condition_variable>  // condition_variable
+#include <cstddef>  // size_t, ptrdiff_t
+#include <cstdint>  // uint64_t
+#include <deque>  // deque
+#include <exception>  // exception_ptr, current_exception, rethrow_exception
+#include <functional>  // function
+#include <iterator>  // reverse_iterator, distance, next
+#include <mutex>  // mutex, lock_guard, unique_lock
+#include <random>  // mt19937
+#include <stdexcept>  // runtime_error
+#include <string>  // string, to_string
+#include <thread>  // thread, hardware_concurrency, yield
+#include <type_traits>  // enable_if, is_convertible
+#include <utility>  // move
+#include <vector>  // vector
+
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/iterator/iterator_categories.hpp>
+
+class json_node_type
+{
+    template<class T>
+    class iter
+      : public boost::iterator_facade<iter<T>, T, boost::random_access_traversal_tag>
+    {
+        struct enabler {};
+        using size_type = typename T::size_type;
+
+     public:
+        // default-constructible and assignable, as required by random access iterators
+        iter() = default;
+
+        explicit iter(T& _n, size_type _i = 0)
+          : n{&_n}, i{_i}
+        {}
+
+        template<class U>
+        iter(const iter<U>& other
+          , std::enable_if_t<std::is_convertible<U*, T*>::value, enabler> = enabler{})
+          : n{other.n}, i{other.i}
+        {}
+
+     private:
+        friend class boost::iterator_core_access;
+
+        template<class> friend class iter;
+
+        template<class U>
+        bool equal(const iter<U>& other) const
+        {
+            return (this->i == other.i) && (this->n == other.n);
+        }
+
+        void increment()
+        {
+            assert(i < n->size());
+            ++i;
+        }
+
+        void decrement()
+        {
+            assert(i > 0);
+            --i;
+        }
+
+        void advance(std::ptrdiff_t d)
+        {
+            assert((static_cast<std::ptrdiff_t>(i) + d >= 0)
+                && (static_cast<std::ptrdiff_t>(i) + d <= static_cast<std::ptrdiff_t>(n->size())));
+            i += d;
+        }
+
+        template<class U>
+        std::ptrdiff_t distance_to(const iter<U>& other) const
+        {
+            assert(this->n == other.n);
+
+            return static_cast<std::ptrdiff_t>(other.i) - static_cast<std::ptrdiff_t>(this->i);
+        }
+
+        T& dereference() const
+        {
+            assert(i < n->size());
+
+            return (i == 0) ? *n : n->tail[i - 1];
+        }
+
+        T* n = nullptr;
+        size_type i = 0;
+    };
+
+ public:
+
+    using tail_type = std::vector<json_node_type>;
+    using size_type = tail_type::size_type;
+    using iterator = iter<json_node_type>;
+    using const_iterator = iter<const json_node_type>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    json_node_type() = default;
+    explicit json_node_type(std::string d) : data{std::move(d)} {}
+
+    size_type size() const noexcept { return 1 + tail.size(); }
+
+    iterator begin() noexcept { return iterator{*this, 0}; }
+    const_iterator begin() const noexcept { return const_iterator{*this, 0}; }
+
+    iterator end() noexcept { return iterator{*this, size()}; }
+    const_iterator end() const noexcept { return const_iterator{*this, size()}; }
+
+    const_iterator cbegin() const noexcept { return const_iterator{*this, 0}; }
+    const_iterator cend() const noexcept { return const_iterator{*this, size()}; }
+
+    reverse_iterator rbegin() noexcept { return reverse_iterator{end()}; }
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator{end()}; }
+
+    reverse_iterator rend() noexcept { return reverse_iterator{begin()}; }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator{begin()}; }
+
+    const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+    const_reverse_iterator crend() const noexcept { return rend(); }
+
+    /** NOTE: Head is not stored together with the tail, so that only tail is contiguous. */
+    json_node_type* tail_data() noexcept { return tail.data(); }
+    const json_node_type* tail_data() const noexcept { return tail.data(); }
+
+    void push_back(json_node_type&& n) { tail.push_back(std::forward<json_node_type>(n)); }
+    void push_back(const json_node_type& n) { tail.push_back(n); }
+
+    /** NOTE: Resizes into @c size equal to @c n+1 value. */
+    void resize(size_type n) { tail.resize(n); }
+
+    const std::string& value() const noexcept { return data; }
+
+ private:
+    std::string data;
+    tail_type tail;
+};
+
+
+
+// ------------------------------------
+
+
+// Every worker owns a deque: it pushes and pops its own tasks at the back,
+// idle workers steal from the front of the others' deques (oldest, thus
+// usually the biggest, tasks). The thread that waits for a group helps.
+// A task that throws does not stop its worker: the first exception of a
+// group is rethrown by wait once all the tasks of the group are done.
+class work_stealing_pool
+{
+    struct queue
+    {
+        std::mutex m;
+        std::deque<std::function<void()>> tasks;
+    };
+
+ public:
+
+    class task_group
+    {
+        friend class work_stealing_pool;
+
+        void fail(std::exception_ptr e)
+        {
+            std::lock_guard<std::mutex> lock{m};
+
+            if ( ! error) error = std::move(e);
+        }
+
+        std::atomic<std::size_t> pending{0};
+        std::mutex m;
+        std::exception_ptr error;  // first one thrown
+    };
+
+    // The calling thread is worker 0, thus workers - 1 threads are started.
+    // Only one thread outside of the pool may spawn and wait: all of them
+    // would be worker 0, sharing its index (and per worker data indexed by it).
+    explicit work_stealing_pool(unsigned workers = std::max(1u, std::thread::hardware_concurrency()))
+      : queues(workers)
+    {
+        for (unsigned w = 1; w < workers; ++w) threads.emplace_back([this, w] { loop(w); });
+    }
+
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator= (const work_stealing_pool&) = delete;
+
+    ~work_stealing_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock{sleep};
+            stop = true;
+        }
+
+        wake.notify_all();
+
+        for (auto& t : threads) t.join();
+    }
+
+    unsigned size() const noexcept { return static_cast<unsigned>(queues.size()); }
+
+    // Index of the calling worker, 0 outside of the pool.
+    unsigned self() const noexcept { return (owner == this) ? index : 0; }
+
+    template<class F>
+    void spawn(task_group& g, F f)
+    {
+        assert(single_outside());
+
+        g.pending.fetch_add(1, std::memory_order_relaxed);
+
+        queue& q = queues[self()];
+
+        try
+        {
+            std::lock_guard<std::mutex> lock{q.m};
+
+            q.tasks.emplace_back([&g, f = std::move(f)]
+            {
+                try { f(); }
+                catch (...) { g.fail(std::current_exception()); }
+
+                g.pending.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        catch (...)
+        {
+            g.pending.fetch_sub(1, std::memory_order_relaxed);
+            throw;
+        }
+
+        {
+            // under the lock a worker cannot be between its check of queued and its wait
+            std::lock_guard<std::mutex> lock{sleep};
+            queued.fetch_add(1, std::memory_order_release);
+        }
+
+        wake.notify_one();
+    }
+
+    // Runs the pool's tasks until all the tasks of the group are done, then
+    // rethrows the first exception thrown by any of them.
+    void wait(task_group& g)
+    {
+        assert(single_outside());
+
+        while (g.pending.load(std::memory_order_acquire) > 0)
+        {
+            if ( ! run_one(self())) std::this_thread::yield();
+        }
+
+        if (g.error) std::rethrow_exception(g.error);
+    }
+
+    // As wait, for the unwinding caller: tasks refer to g, which must not go
+    // out of scope before they are done, their exceptions are dropped.
+    void drain(task_group& g) noexcept
+    {
+        try { wait(g); } catch (...) {}
+    }
+
+ private:
+    // The first thread outside of the pool that spawns or waits is the only one.
+    bool single_outside() noexcept
+    {
+        if (owner == this) return true;
+
+        const std::thread::id me = std::this_thread::get_id();
+        std::thread::id seen = outside.load(std::memory_order_relaxed);
+
+        return (seen == me) || ((seen == std::thread::id{}) && outside.compare_exchange_strong(seen, me, std::memory_order_relaxed));
+    }
+
+    bool run_one(unsigned w)
+    {
+        std::function<void()> task;
+
+        if ( ! pop(w, task))
+        {
+            for (unsigned k = 1; k < queues.size(); ++k)
+            {
+                if (steal((w + k) % queues.size(), task)) break;
+            }
+        }
+
+        if ( ! task) return false;
+
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        task();
+
+        return true;
+    }
+
+    bool pop(unsigned w, std::function<void()>& task)
+    {
+        queue& q = queues[w];
+        std::lock_guard<std::mutex> lock{q.m};
+
+        if (q.tasks.empty()) return false;
+
+        task = std::move(q.tasks.back());
+        q.tasks.pop_back();
+
+        return true;
+    }
+
+    bool steal(unsigned victim, std::function<void()>& task)
+    {
+        queue& q = queues[victim];
+        std::unique_lock<std::mutex> lock{q.m, std::try_to_lock};
+
+        if ( ! lock || q.tasks.empty()) return false;
+
+        task = std::move(q.tasks.front());
+        q.tasks.pop_front();
+
+        return true;
+    }
+
+    void loop(unsigned w)
+    {
+        owner = this;
+        index = w;
+
+        for (;;)
+        {
+            if (run_one(w)) continue;
+
+            std::unique_lock<std::mutex> lock{sleep};
+
+            wake.wait(lock, [this] { return stop || (queued.load(std::memory_order_acquire) > 0); });
+
+            if (stop) return;
+        }
+    }
+
+    std::vector<queue> queues;
+    std::vector<std::thread> threads;
+
+    std::atomic<std::size_t> queued{0};
+    std::mutex sleep;
+    std::condition_variable wake;
+    bool stop = false;
+
+    std::atomic<std::thread::id> outside{};
+
+    static thread_local const work_stealing_pool* owner;
+    static thread_local unsigned index;
+};
+
+thread_local const work_stealing_pool* work_stealing_pool::owner = nullptr;
+thread_local unsigned work_stealing_pool::index = 0;
+
+
+
+// ---
+
+
+// Size estimate of the subtrees in [first, last): sum of their fan-outs.
+template<class I>
+std::size_t weight(I first, I last)
+{
+    std::size_t r = 0;
+
+    for (; first != last; ++first) r += first->size();
+
+    return r;
+}
+
+// Halves [first, last) while it is heavier than grain, the halves are spawned
+// and may be stolen. Needs random access to split in O(1).
+template<class I, class Leaf>
+void split(work_stealing_pool& pool, I first, I last, std::size_t w, std::size_t grain, const Leaf& leaf)
+{
+    work_stealing_pool::task_group g;
+
+    while (((last - first) > 1) && (w > grain))
+    {
+        const I mid = first + (last - first) / 2;
+
+        w /= 2;
+        pool.spawn(g, [&pool, mid, last, w, grain, &leaf] { split(pool, mid, last, w, grain, leaf); });
+        last = mid;
+    }
+
+    try
+    {
+        leaf(first, last);
+    }
+    catch (...)
+    {
+        pool.drain(g);
+        throw;
+    }
+
+    pool.wait(g);
+}
+
+template<class I, class T, class Leaf, class Reduce>
+T split_reduce(work_stealing_pool& pool, I first, I last, std::size_t w, std::size_t grain
+             , const T& init, const Leaf& leaf, const Reduce& reduce)
+{
+    if (((last - first) > 1) && (w > grain))
+    {
+        const I mid = first + (last - first) / 2;
+
+        work_stealing_pool::task_group g;
+        T right = init;
+
+        pool.spawn(g, [&] { right = split_reduce(pool, mid, last, w / 2, grain, init, leaf, reduce); });
+
+        T left = init;
+
+        try
+        {
+            left = split_reduce(pool, first, mid, w / 2, grain, init, leaf, reduce);
+        }
+        catch (...)
+        {
+            pool.drain(g);
+            throw;
+        }
+
+        pool.wait(g);
+
+        return reduce(std::move(left), std::move(right));
+    }
+
+    return leaf(first, last);
+}
+
+
+
+// ---
+
+
+// Calls f once for every node of the tree, head included, in no particular order.
+template<class F>
+void parallel_for_each_node(work_stealing_pool& pool, const json_node_type& n, const F& f, std::size_t grain = 4096)
+{
+    f(n);
+
+    const json_node_type* first = n.tail_data();
+    const json_node_type* last = first + (n.size() - 1);
+
+    split(pool, first, last, weight(first, last), grain, [&pool, &f, grain](const json_node_type* b, const json_node_type* e)
+    {
+        for (; b != e; ++b) parallel_for_each_node(pool, *b, f, grain);
+    });
+}
+
+
+// Tree of the same shape with f applied to every value.
+template<class F>
+json_node_type parallel_transform(work_stealing_pool& pool, const json_node_type& n, const F& f, std::size_t grain = 4096)
+{
+    json_node_type r{f(n.value())};
+
+    r.resize(n.size() - 1);
+
+    const json_node_type* first = n.tail_data();
+    const json_node_type* last = first + (n.size() - 1);
+
+    json_node_type* out = r.tail_data();
+
+    split(pool, first, last, weight(first, last), grain, [&pool, &f, grain, first, out](const json_node_type* b, const json_node_type* e)
+    {
+        for (; b != e; ++b) out[b - first] = parallel_transform(pool, *b, f, grain);
+    });
+
+    return r;
+}
+
+
+enum class ordering { unspecified, deterministic };
+
+// With ordering::deterministic the partial results are combined along a tree
+// that depends on the shape of the document and on grain only (not on the
+// number of workers, nor on who stole what), and init must be the identity of
+// reduce. Otherwise values are folded into one partial per worker, in the
+// order the worker happens to visit them.
+template<class T, class Reduce, class Transform>
+T parallel_transform_reduce(work_stealing_pool& pool, const json_node_type& root, T init
+                          , Reduce reduce, Transform transform, ordering o = ordering::unspecified, std::size_t grain = 4096)
+{
+    if (o == ordering::deterministic)
+    {
+        struct node_reduce
+        {
+            T operator() (const json_node_type& n) const
+            {
+                const json_node_type* first = n.tail_data();
+                const json_node_type* last = first + (n.size() - 1);
+
+                return reduce(transform(n), split_reduce(*pool, first, last, weight(first, last), grain, init, *this, reduce));
+            }
+
+            T operator() (const json_node_type* b, const json_node_type* e) const
+            {
+                T r = init;
+
+                for (; b != e; ++b) r = reduce(std::move(r), (*this)(*b));
+
+                return r;
+            }
+
+            work_stealing_pool* pool;
+            const T& init;
+            const Reduce& reduce;
+            const Transform& transform;
+            std::size_t grain;
+        };
+
+        return node_reduce{&pool, init, reduce, transform, grain}(root);
+    }
+
+    struct alignas(64) partial { T value; };  // one cache line per worker
+
+    std::vector<partial> partials(pool.size(), partial{init});
+
+    parallel_for_each_node(pool, root, [&](const json_node_type& n)
+    {
+        T& p = partials[pool.self()].value;
+
+        p = reduce(std::move(p), transform(n));
+    }, grain);
+
+    T r = init;
+
+    for (auto& p : partials) r = reduce(std::move(r), std::move(p.value));
+
+    return r;
+}
+
+
+
+// ---
+
+
+// Root with groups of uneven size: a few very big, many small ones.
+json_node_type make_tree(std::size_t nodes)
+{
+    std::mt19937 random{42};
+    json_node_type root{"root"};
+
+    std::size_t made = 1;
+
+    while (made < nodes)
+    {
+        const std::size_t n = std::min<std::size_t>(nodes - made - 1, (random() % 16 == 0) ? 20'000 : 1 + random() % 50);
+        json_node_type group{"group" + std::to_string(made)};
+
+        group.resize(n);
+
+        for (std::size_t i = 0; i < n; ++i) group.tail_data()[i] = json_node_type{std::to_string(random() % 1000) + ".25"};
+
+        root.push_back(std::move(group));
+        made += 1 + n;
+    }
+
+    return root;
+}
+
+// Deliberately expensive per node.
+std::uint64_t work(const std::string& s)
+{
+    std::uint64_t h = 0xcbf29ce484222325;
+
+    for (int r = 0; r < 64; ++r)
+    {
+        for (char c : s) h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+    }
+
+    return h;
+}
+
+template<class F>
+double ms(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    f();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+
+int main()
+{
+    const json_node_type tree = make_tree(2'000'000);
+
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+    std::cout << "hardware threads: " << cores << '\n';
+
+    std::uint64_t expected = 0;
+
+    const double sequential = ms([&]
+    {
+        std::vector<const json_node_type*> stack{&tree};
+
+        while ( ! stack.empty())
+        {
+            const json_node_type* n = stack.back();
+            stack.pop_back();
+
+            expected ^= work(n->value());
+
+            for (auto it = std::next(n->cbegin()); it != n->cend(); ++it) stack.push_back(&*it);
+        }
+    });
+
+    std::cout << "sequential: " << sequential << " ms\n";
+
+    for (unsigned workers : {1u, 2u, 4u, 8u})
+    {
+        work_stealing_pool pool{workers};
+        std::atomic<std::uint64_t> h{0};
+
+        const double t = ms([&] { parallel_for_each_node(pool, tree, [&h](const json_node_type& n) { h.fetch_xor(work(n.value()), std::memory_order_relaxed); }); });
+
+        std::cout << "  " << workers << " workers: " << t << " ms, speed-up " << sequential / t
+                  << " (" << sequential / t / std::min(workers, cores) << " per core)" << (h == expected ? "" : " WRONG") << '\n';
+    }
+
+    {
+        work_stealing_pool pool{4};
+
+        const json_node_type upper = parallel_transform(pool, tree, [](const std::string& s) { return s + "!"; });
+
+        std::cout << "transform: " << upper.value() << ' ' << std::next(upper.cbegin())->value() << ' '
+                  << std::next(std::next(upper.cbegin())->cbegin())->value() << '\n';
+    }
+
+    {
+        work_stealing_pool pool{4};
+        std::atomic<std::size_t> visited{0};
+
+        try
+        {
+            parallel_for_each_node(pool, tree, [&visited](const json_node_type& n)
+            {
+                if (n.value() == "group1") throw std::runtime_error{"bad node " + n.value()};
+
+                visited.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << "thrown: " << e.what();
+        }
+
+        visited = 0;
+        parallel_for_each_node(pool, tree, [&visited](const json_node_type&) { visited.fetch_add(1, std::memory_order_relaxed); });
+
+        std::cout << ", then visited " << visited << " nodes\n";
+    }
+
+    const auto sum = [](double a, double b) { return a + b; };
+    const auto number = [](const json_node_type& n) { return (n.value()[0] >= '0') && (n.value()[0] <= '9') ? std::stod(n.value()) * 1.1 : 0.0; };
+
+    for (ordering o : {ordering::unspecified, ordering::deterministic})
+    {
+        std::cout << ((o == ordering::deterministic) ? "deterministic:" : "unspecified:  ");
+
+        for (unsigned workers : {1u, 3u, 4u})
+        {
+            work_stealing_pool pool{workers};
+
+            std::cout.precision(17);
+            std::cout << ' ' << parallel_transform_reduce(pool, tree, 0.0, sum, number, o, 64);
+        }
+
+        std::cout << '\n';
+    }
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+hardware threads: 1
+sequential: 1186.65 ms
+  1 workers: 1242.74 ms, speed-up 0.95487 (0.95487 per core)
+  2 workers: 1236.69 ms, speed-up 0.959534 (0.959534 per core)
+  4 workers: 1237.9 ms, speed-up 0.958598 (0.958598 per core)
+  8 workers: 1243.75 ms, speed-up 0.954092 (0.954092 per core)
+transform: root! group1! 876.25!
+thrown: bad node group1, then visited 2000000 nodes
+unspecified:   1098668226.4249983 1098668226.4250081 1098668226.4250004
+deterministic: 1098668226.4250002 1098668226.4250002 1098668226.4250002
+
+Measured on a single hardware thread: extra workers only add the cost of
+scheduling. Speed-up per core is expected to stay close to 1 with one
+worker per core, given enough nodes per grain.
+*/
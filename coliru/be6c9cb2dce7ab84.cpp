@@ -0,0 +1,435 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout
+#include <iomanip>  // setw, setprecision
+
+#include <algorithm>  // push_heap, pop_heap, find_if, max
+#include <array>  // array
+#include <cassert>  // assert
+#include <chrono>  // steady_clock
+#include <cstddef>  // size_t
+#include <map>  // map
+#include <memory>  // shared_ptr, unique_ptr
+#include <mutex>  // mutex, lock_guard
+#include <new>  // bad_alloc
+#include <optional>  // optional
+#include <random>  // mt19937, uniform_int_distribution
+#include <string>  // string
+#include <utility>  // pair, move
+
+#include <Eigen/Dense>
+
+
+
+// State model from coliru/2d6a8f04c1e9b753.cpp.
+template<class T>
+using slot = std::pair<T*, std::size_t>;
+
+enum class state { unborn, free, occupied, dead };
+
+template<class T>
+state state_of(const slot<T>& s)
+{
+    if (s.first == nullptr) return (s.second == 0) ? state::unborn : state::dead;
+
+    return (s.second == 0) ? state::free : state::occupied;
+}
+
+struct by_preference
+{
+    template<class T>
+    bool operator() (const slot<T>& a, const slot<T>& b) const { return rank(a) < rank(b); }
+
+    template<class T>
+    static int rank(const slot<T>& s)
+    {
+        switch (state_of(s))
+        {
+            case state::free: return 3;
+            case state::unborn: return 2;
+            case state::occupied: return 1;
+            default: return 0;
+        }
+    }
+};
+
+enum class pool_error { none, exhausted, no_memory };
+
+
+
+// ------------------------------------
+
+
+// Reuse policies: may a free object of the given capacity serve a request
+// of n elements? Candidates are visited in ascending capacity, starting
+// at n, and the first free one is taken -- best fit among the accepted.
+
+// Only the class of exactly n elements.
+struct exact_fit
+{
+    bool operator() (std::size_t n, std::size_t capacity) const { return capacity == n; }
+
+    std::string name() const { return "exact"; }
+};
+
+// Any class at least as large.
+struct best_fit
+{
+    bool operator() (std::size_t n, std::size_t capacity) const { return capacity >= n; }
+
+    std::string name() const { return "best fit"; }
+};
+
+// Classes at most percent larger than requested.
+struct within
+{
+    bool operator() (std::size_t n, std::size_t capacity) const { return (capacity >= n) && (capacity * 100 <= n * (100 + percent)); }
+
+    std::string name() const { return "within " + std::to_string(percent) + "%"; }
+
+    std::size_t percent;
+};
+
+
+// All the sizes are in elements.
+struct pool_stats
+{
+    double hit_rate() const { return requests ? double(hits) / requests : 0; }
+
+    // Part of the granted capacity not asked for.
+    double waste() const { return granted ? 1 - double(requested) / granted : 0; }
+
+    // Part of the free capacity not usable by a request as large as all of it.
+    double fragmentation() const { return free ? 1 - double(largest_free) / free : 0; }
+
+    std::size_t requests = 0;
+    std::size_t hits = 0;  // served by a free object
+    std::size_t larger = 0;  // ... of a larger class
+    std::size_t allocations = 0;
+    std::size_t failures = 0;
+
+    std::size_t requested = 0;  // cumulative
+    std::size_t granted = 0;  // cumulative
+
+    std::size_t held = 0;  // allocated by the pool
+    std::size_t free = 0;
+    std::size_t largest_free = 0;
+};
+
+
+
+// ---
+
+
+// Matrices are pooled by their capacity (number of elements) and handed out
+// as a view of the requested dimensions over the storage -- a resize would
+// reallocate any Eigen matrix whose number of elements changes. Any class of
+// capacity c serves all the (rows, cols) with rows * cols <= c, so the two
+// dimensional intervals of the article collapse into one: the ordered map
+// of capacities is the interval tree. Policy picks the candidates.
+template<class Scalar, std::size_t max, class Policy>
+class matrix_pool
+{
+    using matrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+    using bucket = std::pair<std::mutex, std::array<slot<matrix>, max>>;
+
+    static void sift_up(std::array<slot<matrix>, max>& slots, std::size_t i)
+    {
+        for (std::size_t parent = (i - 1) / 2; (i > 0) && by_preference{}(slots[parent], slots[i]); i = parent, parent = (i - 1) / 2)
+        {
+            std::swap(slots[parent], slots[i]);
+        }
+    }
+
+    static std::shared_ptr<bucket> make_bucket()
+    {
+        return std::shared_ptr<bucket>(new bucket{}, [](bucket* b) { for (auto& s : b->second) delete s.first; delete b; });
+    }
+
+ public:
+
+    class deleter
+    {
+     public:
+        deleter() = default;
+        explicit deleter(std::shared_ptr<bucket> b) : home{std::move(b)} {}
+
+        void operator() (matrix* p) const
+        {
+            std::lock_guard<std::mutex> lock{home->first};
+
+            auto& slots = home->second;
+            const auto it = std::find_if(slots.begin(), slots.end(), [p](const slot<matrix>& s) { return s.first == p; });
+
+            assert(it != slots.end());
+
+            it->second = 0;  // leave
+            sift_up(slots, static_cast<std::size_t>(it - slots.begin()));
+        }
+
+     private:
+        std::shared_ptr<bucket> home;
+    };
+
+    // Owns the storage, exposes it with the requested dimensions.
+    struct lease
+    {
+        std::unique_ptr<matrix, deleter> storage;
+        Eigen::Map<matrix> view;
+    };
+
+    explicit matrix_pool(Policy p = Policy{}) : policy{std::move(p)} {}
+
+    std::pair<pool_error, std::optional<lease>> construct(Eigen::Index rows, Eigen::Index cols)
+    {
+        const auto n = static_cast<std::size_t>(rows * cols);
+
+        std::lock_guard<std::mutex> lock{m};  // held for the scan, classes are not added meanwhile
+
+        ++counters.requests;
+
+        for (auto it = buckets.lower_bound(n); (it != buckets.end()) && policy(n, it->first); ++it)
+        {
+            std::lock_guard<std::mutex> bucket_lock{it->second->first};
+
+            auto& slots = it->second->second;
+
+            if (state_of(slots.front()) != state::free) continue;  // heap top is the most preferred
+
+            std::pop_heap(slots.begin(), slots.end(), by_preference{});
+            slots.back().second = 1;  // use
+            matrix* p = slots.back().first;
+            std::push_heap(slots.begin(), slots.end(), by_preference{});
+
+            ++counters.hits;
+            counters.larger += (it->first != n);
+
+            return granted(it->second, p, n, it->first, rows, cols);
+        }
+
+        // nothing free among the candidates: allocate in the exact class
+        auto it = buckets.find(n);
+
+        if (it == buckets.end()) it = buckets.emplace(n, make_bucket()).first;
+
+        std::lock_guard<std::mutex> bucket_lock{it->second->first};
+
+        auto& slots = it->second->second;
+
+        std::pop_heap(slots.begin(), slots.end(), by_preference{});
+
+        slot<matrix>& s = slots.back();
+        pool_error e = pool_error::none;
+
+        if (state_of(s) == state::unborn)
+        {
+            try
+            {
+                s.first = new matrix(static_cast<Eigen::Index>(n), 1);  // allocate
+                ++counters.allocations;
+                counters.held += n;
+            }
+            catch (const std::bad_alloc&)
+            {
+                e = pool_error::no_memory;
+            }
+        }
+        else if (state_of(s) != state::free)  // exact class allowed by a policy that rejects it
+        {
+            e = pool_error::exhausted;
+        }
+
+        if (e == pool_error::none) s.second = 1;  // use
+
+        matrix* p = s.first;
+
+        std::push_heap(slots.begin(), slots.end(), by_preference{});
+
+        if (e != pool_error::none)
+        {
+            ++counters.failures;
+            return {e, std::nullopt};
+        }
+
+        return granted(it->second, p, n, n, rows, cols);
+    }
+
+    pool_stats stats()
+    {
+        std::lock_guard<std::mutex> lock{m};
+
+        pool_stats r = counters;
+
+        for (const auto& [capacity, b] : buckets)
+        {
+            std::lock_guard<std::mutex> bucket_lock{b->first};
+
+            for (const auto& s : b->second)
+            {
+                if (state_of(s) != state::free) continue;
+
+                r.free += capacity;
+                r.largest_free = std::max(r.largest_free, capacity);
+            }
+        }
+
+        return r;
+    }
+
+    const Policy& reuse_policy() const noexcept { return policy; }
+
+ private:
+    std::pair<pool_error, std::optional<lease>> granted(const std::shared_ptr<bucket>& b, matrix* p, std::size_t n, std::size_t capacity, Eigen::Index rows, Eigen::Index cols)
+    {
+        counters.requested += n;
+        counters.granted += capacity;
+
+        return {pool_error::none, lease{std::unique_ptr<matrix, deleter>{p, deleter{b}}, Eigen::Map<matrix>{p->data(), rows, cols}}};
+    }
+
+    Policy policy;
+    std::mutex m;  // guards the map and the counters
+    std::map<std::size_t, std::shared_ptr<bucket>> buckets;
+    pool_stats counters;
+};
+
+
+
+// ---
+
+
+template<class F>
+double ms(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    f();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+constexpr std::size_t live = 64;  // matrices alive at a time
+constexpr std::size_t rounds = 1'000'000;
+
+double sink = 0;  // keeps the loops
+
+// Dimensions between 2 and 48 on each side, products are spread over ~700 sizes.
+std::pair<Eigen::Index, Eigen::Index> dimensions(std::mt19937& r)
+{
+    std::uniform_int_distribution<Eigen::Index> side{2, 48};
+
+    return {side(r), side(r)};
+}
+
+template<class Policy>
+void run(Policy p)
+{
+    matrix_pool<double, live, Policy> pool{p};
+    pool_stats s;
+
+    const double t = ms([&]
+    {
+        std::mt19937 r{7};
+        std::array<std::optional<typename matrix_pool<double, live, Policy>::lease>, live> ring;
+
+        for (std::size_t i = 0; i < rounds; ++i)
+        {
+            const auto [rows, cols] = dimensions(r);
+
+            ring[i % live].reset();
+            ring[i % live] = std::move(pool.construct(rows, cols).second);
+            ring[i % live]->view.setConstant(static_cast<double>(i));
+            sink += ring[i % live]->view(0, 0);
+        }
+
+        s = pool.stats();  // with the ring full
+    });
+
+    std::cout << std::setw(12) << pool.reuse_policy().name()
+              << std::setw(10) << std::setprecision(4) << t
+              << std::setw(10) << std::setprecision(3) << 100 * s.hit_rate()
+              << std::setw(10) << 100 * double(s.larger) / s.requests
+              << std::setw(10) << s.allocations
+              << std::setw(10) << s.held * sizeof(double) / 1024
+              << std::setw(10) << 100 * s.waste()
+              << std::setw(10) << 100 * s.fragmentation()
+              << '\n';
+}
+
+
+
+int main()
+{
+    {
+        matrix_pool<double, 2, best_fit> pool;
+
+        auto a = pool.construct(4, 4);
+        const double* storage = a.second->view.data();
+
+        a.second.reset();
+
+        auto b = pool.construct(3, 5);  // 15 <= 16: reuses the 4x4 storage
+        auto c = pool.construct(4, 4);  // nothing free of 16 or more: new
+
+        const pool_stats s = pool.stats();
+
+        std::cout << "best fit reused: " << std::boolalpha << (b.second->view.data() == storage)
+                  << ", view " << b.second->view.rows() << 'x' << b.second->view.cols()
+                  << ", allocations " << s.allocations << ", waste " << s.waste() << '\n';
+    }
+
+    {
+        matrix_pool<double, 2, within> pool{within{10}};
+
+        pool.construct(4, 4);  // returned at once
+
+        const auto a = pool.construct(3, 4);  // 16 is 33% more than 12: rejected
+
+        std::cout << "within 10% rejected 16 for 12: " << (pool.stats().allocations == 2) << '\n';
+    }
+
+    const double plain = ms([]
+    {
+        std::mt19937 r{7};
+        std::array<std::unique_ptr<Eigen::MatrixXd>, live> ring;
+
+        for (std::size_t i = 0; i < rounds; ++i)
+        {
+            const auto [rows, cols] = dimensions(r);
+
+            ring[i % live] = std::make_unique<Eigen::MatrixXd>(rows, cols);
+            ring[i % live]->setConstant(static_cast<double>(i));
+            sink += (*ring[i % live])(0, 0);
+        }
+    });
+
+    std::cout << "new/delete: " << plain << " ms\n";
+
+    std::cout << std::setw(12) << "policy" << std::setw(10) << "ms" << std::setw(10) << "hit %" << std::setw(10) << "larger %"
+              << std::setw(10) << "allocs" << std::setw(10) << "held KiB" << std::setw(10) << "waste %" << std::setw(10) << "frag %" << '\n';
+
+    run(exact_fit{});
+    run(within{5});
+    run(within{10});
+    run(within{25});
+    run(within{50});
+    run(best_fit{});
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread -I/usr/include/eigen3 main.cpp && ./a.out
+best fit reused: true, view 3x5, allocations 2, waste 0.0208333
+within 10% rejected 16 for 12: true
+new/delete: 583.283 ms
+      policy        ms     hit %  larger %    allocs  held KiB   waste %    frag %
+       exact     683.9      99.8         0      2221     12423         0      99.9
+   within 5%     540.4      99.9      42.8       592      2547     0.494      99.2
+  within 10%     477.4       100      56.7       429      1824     0.952      98.8
+  within 25%     403.1       100      71.5       284      1253      2.23      98.1
+  within 50%     388.6       100        79       207       957      3.51      97.1
+    best fit     557.8       100      95.7        98       737      17.1      94.9
+*/
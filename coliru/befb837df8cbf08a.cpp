@@ -0,0 +1,598 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout, cerr, ostream
+
+#include <algorithm>  // push_heap, pop_heap, find_if
+#include <array>  // array
+#include <atomic>  // atomic
+#include <cassert>  // assert
+#include <chrono>  // steady_clock
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+#include <cstdlib>  // free
+#include <map>  // map
+#include <memory>  // shared_ptr, unique_ptr
+#include <mutex>  // mutex, lock_guard
+#include <new>  // bad_alloc
+#include <optional>  // optional
+#include <random>  // mt19937, discrete_distribution
+#include <string>  // string
+#include <tuple>  // tuple
+#include <unordered_map>  // unordered_map
+#include <utility>  // pair, forward, move
+
+#include <cxxabi.h>  // __cxa_demangle
+#include <execinfo.h>  // backtrace, backtrace_symbols
+
+#include <Eigen/Dense>
+
+
+
+// Pool from coliru/2d6a8f04c1e9b753.cpp, condensed, with a census of its slots.
+template<class T>
+using slot = std::pair<T*, std::size_t>;
+
+enum class state { unborn, free, occupied, dead };
+
+template<class T>
+state state_of(const slot<T>& s)
+{
+    if (s.first == nullptr) return (s.second == 0) ? state::unborn : state::dead;
+
+    return (s.second == 0) ? state::free : state::occupied;
+}
+
+struct by_preference
+{
+    template<class T>
+    bool operator() (const slot<T>& a, const slot<T>& b) const { return rank(a) < rank(b); }
+
+    template<class T>
+    static int rank(const slot<T>& s) { return (s.first == nullptr) ? ((s.second == 0) ? 2 : 0) : ((s.second == 0) ? 3 : 1); }
+};
+
+template<class T>
+struct reuse
+{
+    template<class... As>
+    void operator() (T& t, As&&... args) const { t = T(std::forward<As>(args)...); }
+};
+
+template<class S, int R, int C, int O, int MR, int MC>
+struct reuse<Eigen::Matrix<S, R, C, O, MR, MC>>
+{
+    void operator() (Eigen::Matrix<S, R, C, O, MR, MC>& m, Eigen::Index rows, Eigen::Index cols) const { m.resize(rows, cols); }
+};
+
+enum class pool_error { none, exhausted, no_memory };
+
+// Number of slots in each state.
+struct occupancy
+{
+    std::size_t unborn = 0;
+    std::size_t free = 0;
+    std::size_t occupied = 0;
+};
+
+template<class T, std::size_t max, class K = std::tuple<std::size_t, std::size_t>>
+class object_pool
+{
+    using bucket = std::pair<std::mutex, std::array<slot<T>, max>>;
+
+    static void sift_up(std::array<slot<T>, max>& slots, std::size_t i)
+    {
+        for (std::size_t parent = (i - 1) / 2; (i > 0) && by_preference{}(slots[parent], slots[i]); i = parent, parent = (i - 1) / 2)
+        {
+            std::swap(slots[parent], slots[i]);
+        }
+    }
+
+    static std::shared_ptr<bucket> make_bucket()
+    {
+        return std::shared_ptr<bucket>(new bucket{}, [](bucket* b) { for (auto& s : b->second) delete s.first; delete b; });
+    }
+
+ public:
+
+    using key_type = K;
+
+    class deleter
+    {
+     public:
+        deleter() = default;
+        explicit deleter(std::shared_ptr<bucket> b) : home{std::move(b)} {}
+
+        void operator() (T* p) const
+        {
+            std::lock_guard<std::mutex> lock{home->first};
+
+            auto& slots = home->second;
+            const auto it = std::find_if(slots.begin(), slots.end(), [p](const slot<T>& s) { return s.first == p; });
+
+            assert(it != slots.end());
+
+            it->second = 0;
+            sift_up(slots, static_cast<std::size_t>(it - slots.begin()));
+        }
+
+     private:
+        std::shared_ptr<bucket> home;
+    };
+
+    using handle = std::unique_ptr<T, deleter>;
+
+    template<class... As>
+    std::pair<pool_error, std::optional<handle>> construct(const K& k, As&&... args)
+    {
+        std::shared_ptr<bucket> b = find_or_add(k);
+
+        std::lock_guard<std::mutex> lock{b->first};
+
+        auto& slots = b->second;
+
+        std::pop_heap(slots.begin(), slots.end(), by_preference{});
+
+        slot<T>& s = slots.back();
+
+        if (s.second != 0) { std::push_heap(slots.begin(), slots.end(), by_preference{}); return {pool_error::exhausted, std::nullopt}; }
+
+        // the slot goes back to the heap as it was if T cannot be made
+        try
+        {
+            if (s.first == nullptr) s.first = new T(std::forward<As>(args)...);
+            else reuse<T>{}(*s.first, std::forward<As>(args)...);
+        }
+        catch (const std::bad_alloc&)
+        {
+            std::push_heap(slots.begin(), slots.end(), by_preference{});
+            return {pool_error::no_memory, std::nullopt};
+        }
+        catch (...)
+        {
+            std::push_heap(slots.begin(), slots.end(), by_preference{});
+            throw;
+        }
+
+        s.second = 1;
+
+        T* p = s.first;
+
+        std::push_heap(slots.begin(), slots.end(), by_preference{});
+
+        return {pool_error::none, handle{p, deleter{b}}};
+    }
+
+    // Walks all the classes, unborn counts only the classes created so far.
+    occupancy census()
+    {
+        std::lock_guard<std::mutex> lock{m};
+
+        occupancy r;
+
+        for (const auto& [k, b] : buckets)
+        {
+            std::lock_guard<std::mutex> bucket_lock{b->first};
+
+            for (const auto& s : b->second)
+            {
+                switch (state_of(s))
+                {
+                    case state::unborn: ++r.unborn; break;
+                    case state::free: ++r.free; break;
+                    case state::occupied: ++r.occupied; break;
+                    default: break;
+                }
+            }
+        }
+
+        return r;
+    }
+
+ private:
+    std::shared_ptr<bucket> find_or_add(const K& k)
+    {
+        std::lock_guard<std::mutex> lock{m};
+
+        auto it = buckets.find(k);
+
+        if (it == buckets.end()) it = buckets.emplace(k, make_bucket()).first;
+
+        return it->second;
+    }
+
+    std::mutex m;
+    std::map<K, std::shared_ptr<bucket>> buckets;
+};
+
+
+
+// ------------------------------------
+
+
+// Counts of durations in power of two nanosecond ranges: [0, 2), [2, 4), [4, 8), ...
+class latency_histogram
+{
+ public:
+    static constexpr std::size_t ranges = 40;
+
+    void record(std::chrono::nanoseconds d)
+    {
+        const auto ns = static_cast<std::uint64_t>(d.count());
+
+        counts[std::min<std::size_t>(ns ? 64 - __builtin_clzll(ns) : 0, ranges - 1)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Upper bound of the range that holds the p-th fraction of the samples.
+    std::uint64_t percentile(double p) const
+    {
+        std::size_t total = 0;
+
+        for (const auto& c : counts) total += c.load(std::memory_order_relaxed);
+
+        std::size_t seen = 0;
+
+        for (std::size_t i = 0; i < ranges; ++i)
+        {
+            seen += counts[i].load(std::memory_order_relaxed);
+
+            if ((total > 0) && (seen >= p * total)) return std::uint64_t{1} << i;
+        }
+
+        return 0;
+    }
+
+ private:
+    std::array<std::atomic<std::size_t>, ranges> counts{};
+};
+
+
+// Acquire sites are not recorded.
+struct no_sites
+{
+    void acquired(const void*) {}
+    void released(const void*) {}
+
+    std::size_t report(std::ostream&) const { return 0; }
+};
+
+// "binary(mangled+offset) [address]" into "function+offset", as far as it goes.
+std::string symbolise(const char* frame)
+{
+    const std::string s = frame;
+    const auto open = s.find('('), plus = s.find('+', open);
+
+    if ((open == std::string::npos) || (plus == std::string::npos) || (plus == open + 1)) return s;
+
+    int status = 0;
+    char* name = abi::__cxa_demangle(s.substr(open + 1, plus - open - 1).c_str(), nullptr, nullptr, &status);
+
+    const std::string r = (status == 0) ? name + s.substr(plus, s.find(')', plus) - plus) : s;
+
+    std::free(name);
+
+    return r;
+}
+
+// Debug mode: the call stack of every acquire is kept until the object
+// returns, whatever is left at the end has leaked. Stacks are symbolised
+// only in the report (link with -rdynamic to see function names).
+class acquire_sites
+{
+    static constexpr int depth = 8;
+
+    struct trace
+    {
+        std::array<void*, depth> frames;
+        int size;
+    };
+
+ public:
+    void acquired(const void* p)
+    {
+        trace t;
+        t.size = ::backtrace(t.frames.data(), depth);
+
+        std::lock_guard<std::mutex> lock{m};
+
+        outstanding[p] = t;
+    }
+
+    void released(const void* p)
+    {
+        std::lock_guard<std::mutex> lock{m};
+
+        outstanding.erase(p);
+    }
+
+    std::size_t report(std::ostream& os) const
+    {
+        std::lock_guard<std::mutex> lock{m};
+
+        for (const auto& [p, t] : outstanding)
+        {
+            os << "outstanding " << p << " acquired at:\n";
+
+            char** symbols = ::backtrace_symbols(t.frames.data(), t.size);
+
+            for (int i = 0; i < t.size; ++i) os << "    " << (symbols ? symbolise(symbols[i]) : "?") << '\n';
+
+            std::free(symbols);
+        }
+
+        return outstanding.size();
+    }
+
+ private:
+    mutable std::mutex m;
+    std::unordered_map<const void*, trace> outstanding;
+};
+
+
+// What a pool reports when asked, or when it runs dry.
+struct pool_report
+{
+    occupancy slots;
+    std::size_t high_water = 0;  // most objects occupied at once
+    std::size_t acquired = 0;
+    std::size_t released = 0;
+    std::size_t exhausted = 0;
+    std::size_t no_memory = 0;
+    std::uint64_t p50 = 0, p99 = 0, p999 = 0;  // acquire latency, ns
+};
+
+std::ostream& operator<< (std::ostream& os, const pool_report& r)
+{
+    return os << "unborn " << r.slots.unborn << ", free " << r.slots.free << ", occupied " << r.slots.occupied
+              << ", high water " << r.high_water
+              << "; acquired " << r.acquired << ", released " << r.released
+              << "; failed: exhausted " << r.exhausted << ", no memory " << r.no_memory
+              << "; acquire p50 < " << r.p50 << " ns, p99 < " << r.p99 << " ns, p99.9 < " << r.p999 << " ns";
+}
+
+
+// Wraps any pool whose construct returns (pool_error, optional<unique_ptr<T, D>>)
+// and that provides census(). Counters are relaxed atomics updated on acquire
+// and release; handles carry the monitor, so that they may outlive the pool
+// as the pool's own handles do. Sites is no_sites or acquire_sites.
+template<class Pool, class Sites = no_sites>
+class observed
+{
+    using inner = typename Pool::handle;
+    using T = typename inner::element_type;
+
+    struct monitor
+    {
+        std::atomic<std::size_t> acquired{0};
+        std::atomic<std::size_t> released{0};
+        std::atomic<std::size_t> occupied{0};
+        std::atomic<std::size_t> high_water{0};
+        std::atomic<std::size_t> exhausted{0};
+        std::atomic<std::size_t> no_memory{0};
+        latency_histogram latency;
+        Sites sites;
+    };
+
+ public:
+
+    using key_type = typename Pool::key_type;
+
+    class deleter
+    {
+     public:
+        deleter() = default;
+        deleter(typename inner::deleter_type d, std::shared_ptr<monitor> m) : pass{std::move(d)}, mon{std::move(m)} {}
+
+        void operator() (T* p) const
+        {
+            mon->sites.released(p);
+            mon->occupied.fetch_sub(1, std::memory_order_relaxed);
+            mon->released.fetch_add(1, std::memory_order_relaxed);
+
+            pass(p);
+        }
+
+     private:
+        typename inner::deleter_type pass;
+        std::shared_ptr<monitor> mon;
+    };
+
+    using handle = std::unique_ptr<T, deleter>;
+
+    observed() = default;
+
+    observed(const observed&) = delete;
+    observed& operator= (const observed&) = delete;
+
+    // Anything still out at the end is reported as a leak.
+    ~observed()
+    {
+        if (mon->occupied.load() > 0)
+        {
+            std::cerr << "pool destroyed with objects out: " << report() << '\n';
+            mon->sites.report(std::cerr);
+        }
+    }
+
+    template<class... As>
+    std::pair<pool_error, std::optional<handle>> construct(const key_type& k, As&&... args)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        auto r = pool.construct(k, std::forward<As>(args)...);
+
+        mon->latency.record(std::chrono::steady_clock::now() - start);
+
+        if ( ! r.second)
+        {
+            ((r.first == pool_error::exhausted) ? mon->exhausted : mon->no_memory).fetch_add(1, std::memory_order_relaxed);
+
+            return {r.first, std::nullopt};
+        }
+
+        inner& h = *r.second;
+        T* p = h.get();
+
+        handle out{p, deleter{h.get_deleter(), mon}};
+        h.release();
+
+        mon->acquired.fetch_add(1, std::memory_order_relaxed);
+
+        const std::size_t now = mon->occupied.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        for (std::size_t top = mon->high_water.load(std::memory_order_relaxed); (now > top) && ! mon->high_water.compare_exchange_weak(top, now, std::memory_order_relaxed); ) {}
+
+        mon->sites.acquired(p);
+
+        return {pool_error::none, std::move(out)};
+    }
+
+    pool_report report()
+    {
+        pool_report r;
+
+        r.slots = pool.census();
+        r.high_water = mon->high_water.load();
+        r.acquired = mon->acquired.load();
+        r.released = mon->released.load();
+        r.exhausted = mon->exhausted.load();
+        r.no_memory = mon->no_memory.load();
+        r.p50 = mon->latency.percentile(0.5);
+        r.p99 = mon->latency.percentile(0.99);
+        r.p999 = mon->latency.percentile(0.999);
+
+        return r;
+    }
+
+    // Number of objects out, with their acquire sites in the debug mode.
+    std::size_t leaks(std::ostream& os) const
+    {
+        mon->sites.report(os);
+
+        return mon->occupied.load();
+    }
+
+ private:
+    Pool pool;
+    std::shared_ptr<monitor> mon = std::make_shared<monitor>();
+};
+
+
+
+// ---
+
+
+template<class F>
+double ms(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    f();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+constexpr std::size_t live = 32;
+
+// Small matrices replaced in a ring, as in coliru/2d6a8f04c1e9b753.cpp.
+template<class Pool>
+double ring(Pool& pool, std::size_t rounds)
+{
+    return ms([&]
+    {
+        std::mt19937 r{7};
+        std::discrete_distribution<int> pick{30, 25, 15, 10};
+        constexpr std::array<int, 4> sides{3, 4, 6, 8};
+
+        std::array<typename Pool::handle, live> ring;
+        double sink = 0;
+
+        for (std::size_t i = 0; i < rounds; ++i)
+        {
+            const int n = sides[pick(r)];
+
+            ring[i % live].reset();
+            ring[i % live] = std::move(*pool.construct({n, n}, n, n).second);
+            ring[i % live]->setConstant(static_cast<double>(i));
+            sink += (*ring[i % live])(0, 0);
+        }
+
+        if (sink < 0) std::cout << sink;
+    });
+}
+
+[[gnu::noinline]] auto forgotten(observed<object_pool<Eigen::MatrixXd, 4>, acquire_sites>& pool)
+{
+    return std::move(*pool.construct({3, 3}, 3, 3).second);
+}
+
+
+
+int main()
+{
+    {
+        observed<object_pool<Eigen::MatrixXd, 4>> pool;
+
+        std::array<std::optional<observed<object_pool<Eigen::MatrixXd, 4>>::handle>, 5> all;
+
+        for (auto& h : all) h = std::move(pool.construct({3, 3}, 3, 3).second);  // the fifth fails
+
+        constexpr std::size_t huge = std::size_t{1} << 40;
+
+        const bool refused = ( ! pool.construct({huge, huge}, huge, huge).second);  // no memory, the slot stays unborn
+        const bool reused = pool.construct({huge, huge}, 1, 1).second.has_value();
+
+        std::cout << "no memory: refused " << std::boolalpha << refused << ", slot usable " << reused << '\n';
+
+        all[0].reset();
+        all[1].reset();
+
+        std::cout << "ran dry: " << pool.report() << "\n\n";
+
+        for (auto& h : all) h.reset();
+    }
+
+    {
+        observed<object_pool<Eigen::MatrixXd, 4>, acquire_sites> pool;
+
+        auto kept = pool.construct({3, 3}, 3, 3);
+        auto lost = forgotten(pool);
+
+        kept.second.reset();
+
+        std::cout << "leaks: " << pool.leaks(std::cout) << "\n\n";
+    }
+
+    constexpr std::size_t rounds = 2'000'000;
+
+    object_pool<Eigen::MatrixXd, live> plain;
+    observed<object_pool<Eigen::MatrixXd, live>> counted;
+    observed<object_pool<Eigen::MatrixXd, live>, acquire_sites> traced;
+
+    std::cout << "plain:    " << ring(plain, rounds) << " ms\n";
+    std::cout << "counters: " << ring(counted, rounds) << " ms\n";
+    std::cout << "sites:    " << ring(traced, rounds) << " ms\n";
+    std::cout << "report:   " << counted.report() << '\n';
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread -rdynamic -I/usr/include/eigen3 main.cpp && ./a.out
+no memory: refused true, slot usable true
+ran dry: unborn 3, free 3, occupied 2, high water 5; acquired 5, released 3; failed: exhausted 1, no memory 1; acquire p50 < 512 ns, p99 < 65536 ns, p99.9 < 65536 ns
+
+leaks: outstanding 0x55dadd3c8190 acquired at:
+    std::pair<pool_error, std::optional<std::unique_ptr<Eigen::Matrix<double, -1, -1, 0, -1, -1>, observed<object_pool<Eigen::Matrix<double, -1, -1, 0, -1, -1>, 4ul, std::tuple<unsigned long, unsigned long> >, acquire_sites>::deleter> > > observed<object_pool<Eigen::Matrix<double, -1, -1, 0, -1, -1>, 4ul, std::tuple<unsigned long, unsigned long> >, acquire_sites>::construct<int, int>(std::tuple<unsigned long, unsigned long> const&, int&&, int&&)+0x16a
+    forgotten(observed<object_pool<Eigen::Matrix<double, -1, -1, 0, -1, -1>, 4ul, std::tuple<unsigned long, unsigned long> >, acquire_sites>&)+0x3e
+    ./a.out(main+0x616) [0x55daa6c2da66]
+    /lib/x86_64-linux-gnu/libc.so.6(+0x2724a) [0x7fd12d84524a]
+    /lib/x86_64-linux-gnu/libc.so.6(__libc_start_main+0x85) [0x7fd12d845305]
+    ./a.out(_start+0x21) [0x55daa6c2e161]
+1
+
+plain:    416.057 ms
+counters: 558.118 ms
+sites:    5330.58 ms
+report:   unborn 47, free 81, occupied 0, high water 32; acquired 2000000, released 2000000; failed: exhausted 0, no memory 0; acquire p50 < 128 ns, p99 < 256 ns, p99.9 < 256 ns
+*/
@@ -0,0 +1,297 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout
+
+#include <algorithm>  // min
+#include <array>  // array
+#include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+#include <ios>  // hex
+#include <map>  // map
+#include <optional>  // optional
+#include <string>  // string
+#include <string_view>  // string_view
+#include <tuple>  // tuple, tuple_element_t
+#include <type_traits>  // remove_cvref, false_type, true_type
+#include <utility>  // index_sequence
+#include <vector>  // vector
+
+
+
+// Leaf names, one per type (not per container/type pair).
+template<class T>
+struct name_of;
+
+template<> struct name_of<int>         { static constexpr std::string_view value = "Int"; };
+template<> struct name_of<long>        { static constexpr std::string_view value = "Long"; };
+template<> struct name_of<double>      { static constexpr std::string_view value = "Double"; };
+template<> struct name_of<bool>        { static constexpr std::string_view value = "Bool"; };
+template<> struct name_of<char>        { static constexpr std::string_view value = "Char"; };
+template<> struct name_of<std::string> { static constexpr std::string_view value = "String"; };
+
+
+// How an instance of S is rendered, one per type constructor:
+// prefix, first `arity` parameters joined with separator, suffix.
+template<template<class...> class S>
+struct shape_of;
+
+template<>
+struct shape_of<std::optional>
+{
+    static constexpr std::string_view prefix = "Maybe[", separator = "", suffix = "]";
+    static constexpr std::size_t arity = 1;
+};
+
+template<>
+struct shape_of<std::vector>
+{
+    static constexpr std::string_view prefix = "[", separator = "", suffix = "]";
+    static constexpr std::size_t arity = 1;  // skip allocator
+};
+
+template<>
+struct shape_of<std::map>
+{
+    static constexpr std::string_view prefix = "Map[", separator = ", ", suffix = "]";
+    static constexpr std::size_t arity = 2;  // skip comparator and allocator
+};
+
+template<>
+struct shape_of<std::tuple>
+{
+    static constexpr std::string_view prefix = "(", separator = ", ", suffix = ")";
+    static constexpr std::size_t arity = static_cast<std::size_t>(-1);  // all of them
+};
+
+
+
+// ---
+
+
+template<class T, class = void>
+struct has_name : std::false_type {};
+
+template<class T>
+struct has_name<T, std::void_t<decltype(name_of<T>::value)>> : std::true_type {};
+
+
+template<template<class...> class S, class = void>
+struct has_shape : std::false_type {};
+
+template<template<class...> class S>
+struct has_shape<S, std::void_t<decltype(shape_of<S>::arity)>> : std::true_type {};
+
+
+template<class T>
+struct deconstruct : std::false_type {};
+
+template<template<class...> class S, class... Ts>
+struct deconstruct<S<Ts...>> : std::true_type
+{
+    using shape = shape_of<S>;
+    using type = std::tuple<Ts...>;
+};
+
+template<template<class...> class S, class T>
+constexpr bool is_instance_of = false;
+
+template<template<class...> class S, class... Ts>
+constexpr bool is_instance_of<S, S<Ts...>> = true;
+
+template<class T>
+constexpr bool is_shaped = false;
+
+template<template<class...> class S, class... Ts>
+constexpr bool is_shaped<S<Ts...>> = has_shape<S>::value;
+
+
+// Compiler-specific spelling, used for the types nobody gave a name.
+template<class T>
+constexpr std::string_view pretty_name()
+{
+    constexpr std::string_view p = __PRETTY_FUNCTION__;  // "... [with T = int; ...]"
+    constexpr auto b = p.find("T = ") + 4;
+
+    // T ends at the first ';' or ']' outside of its own brackets, e.g. std::array<int [2], 3>
+    int depth = 0;
+    auto e = b;
+
+    for (; e < p.size(); ++e)
+    {
+        const char c = p[e];
+
+        if ((c == '<') || (c == '(') || (c == '[')) ++depth;
+        else if ((depth == 0) && ((c == ';') || (c == ']'))) break;
+        else if ((c == '>') || (c == ')') || (c == ']')) --depth;
+    }
+
+    return p.substr(b, e - b);
+}
+
+
+template<class T, class Out>
+constexpr void render(Out& out);
+
+template<class Ts, class Shape, class Out, std::size_t... Is>
+constexpr void render_each(Out& out, std::index_sequence<Is...>)
+{
+    ((out(Is ? Shape::separator : std::string_view{}), render<std::tuple_element_t<Is, Ts>>(out)), ...);
+}
+
+// Out is a sink of string_view parts: either counts or copies them.
+template<class T, class Out>
+constexpr void render(Out& out)
+{
+    if constexpr (has_name<T>::value)
+    {
+        out(name_of<T>::value);
+    }
+    else if constexpr (is_shaped<T>)
+    {
+        using shape = typename deconstruct<T>::shape;
+        using parameters = typename deconstruct<T>::type;
+
+        constexpr std::size_t n = std::min(shape::arity, std::tuple_size_v<parameters>);
+
+        out(shape::prefix);
+        render_each<parameters, shape>(out, std::make_index_sequence<n>{});
+        out(shape::suffix);
+    }
+    else
+    {
+        out(pretty_name<T>());
+    }
+}
+
+
+struct counter
+{
+    constexpr void operator() (std::string_view s) { size += s.size(); }
+
+    std::size_t size = 0;
+};
+
+template<std::size_t N>
+struct writer
+{
+    constexpr void operator() (std::string_view s) { for (char c : s) buffer[size++] = c; }
+
+    std::array<char, N> buffer{};
+    std::size_t size = 0;
+};
+
+
+template<class T>
+struct type_name
+{
+    static constexpr std::size_t size = [] { counter c; render<T>(c); return c.size; }();
+
+    static constexpr std::array<char, size> buffer = [] { writer<size> w; render<T>(w); return w.buffer; }();
+
+    static constexpr std::string_view value{buffer.data(), size};
+};
+
+constexpr std::uint64_t fnv1a(std::string_view s)
+{
+    std::uint64_t h = 0xcbf29ce484222325;
+
+    for (char c : s) h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+
+    return h;
+}
+
+
+// Usable in constant expressions (static_assert, case labels, template arguments).
+template<class T>
+inline constexpr std::string_view type_name_v = type_name<T>::value;
+
+// Stable as long as all the parts are named (not taken from pretty_name).
+template<class T>
+inline constexpr std::uint64_t type_hash_v = fnv1a(type_name_v<T>);
+
+
+// Run-time registry entry: constant-initialised, or the program is ill-formed.
+struct type_entry
+{
+    std::string_view name;
+    std::uint64_t hash;
+};
+
+template<class T>
+inline constinit type_entry type_entry_v{type_name_v<T>, type_hash_v<T>};
+
+
+
+// ---
+
+
+template<template<class...> class S>
+struct stringify
+{
+    template<class T>
+    constexpr std::string_view operator() (T&&) const
+    {
+        using type = std::remove_cvref_t<T>;
+
+        static_assert(is_instance_of<S, type>, "T shall be an instance of S");
+
+        return type_name_v<type>;
+    }
+};
+
+
+struct unnamed {};
+
+
+static_assert(type_name_v<std::vector<int>> == "[Int]");
+static_assert(type_name_v<std::optional<std::vector<double>>> == "Maybe[[Double]]");
+static_assert(type_name_v<std::map<std::string, std::tuple<int, bool>>> == "Map[String, (Int, Bool)]");
+static_assert(type_hash_v<std::vector<int>> != type_hash_v<std::vector<long>>);
+
+
+
+int main()
+{
+    std::optional<int> oi;
+    std::optional<double> od;
+
+    std::cout << stringify<std::optional>{}(oi) << '\n';
+    std::cout << stringify<std::optional>{}(od) << '\n';
+
+    std::vector<int> vi;
+    std::vector<double> vd;
+
+    std::cout << stringify<std::vector>{}(vi) << '\n';
+    std::cout << stringify<std::vector>{}(vd) << '\n';
+
+    std::vector<std::optional<int>> vo;
+    std::map<std::string, std::vector<long>> m;
+
+    std::cout << stringify<std::vector>{}(vo) << '\n';
+    std::cout << stringify<std::map>{}(m) << '\n';
+
+    std::cout << type_name_v<std::vector<unnamed>> << '\n';
+    std::cout << type_name_v<std::vector<std::array<int[2], 3>>> << '\n';
+
+    for (const type_entry& t : {type_entry_v<std::vector<int>>, type_entry_v<std::vector<double>>})
+    {
+        std::cout << t.name << ' ' << std::hex << t.hash << '\n';
+    }
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++20 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+Maybe[Int]
+Maybe[Double]
+[Int]
+[Double]
+[Maybe[Int]]
+Map[String, [Long]]
+[unnamed]
+[std::array<int [2], 3>]
+[Int] 1c04247bb626d4ba
+[Double] dc852552f94f174e
+*/
@@ -0,0 +1,590 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout, cerr
+
+#include <algorithm>  // sort, find
+#include <array>  // array
+#include <atomic>  // atomic
+#include <chrono>  // steady_clock
+#include <cstddef>  // size_t
+#include <cstdint>  // uint8_t, uint32_t, uint64_t
+#include <cstdlib>  // abort
+#include <fstream>  // ifstream
+#include <limits>  // numeric_limits
+#include <new>  // placement new
+#include <sstream>  // istringstream
+#include <string>  // string, to_string
+#include <thread>  // thread
+#include <type_traits>  // invoke_result
+#include <utility>  // forward, move, pair
+#include <vector>  // vector
+
+#include <sched.h>  // sched_getcpu, sched_setaffinity, sched_getaffinity
+#include <sys/mman.h>  // mmap
+#include <sys/syscall.h>  // SYS_mbind, SYS_get_mempolicy
+#include <unistd.h>  // sysconf, syscall
+
+
+
+[[noreturn]] void fatal(const char* what)
+{
+    std::cerr << "fatal: " << what << std::endl;
+    std::abort();
+}
+
+
+// Maybe-like result of occupy, as in coliru/3f1f7afeb51db795.cpp.
+template<class T>
+class maybe
+{
+ public:
+    maybe() = default;  // Nothing
+    explicit maybe(T* _p) : p{_p} {}
+
+    explicit operator bool() const noexcept { return p != nullptr; }
+
+    T& operator*() const { if (p == nullptr) fatal("Nothing dereferenced"); return *p; }
+    T* operator->() const { return &**this; }
+
+    T* get() const noexcept { return p; }
+
+    // f : T& -> maybe<U>
+    template<class F>
+    std::invoke_result_t<F, T&> and_then(F&& f) const { return p ? f(*p) : std::invoke_result_t<F, T&>{}; }
+
+ private:
+    T* p = nullptr;
+};
+
+
+// ------------------------------------
+
+
+// Memory policy system calls, used directly: libnuma is not everywhere.
+namespace numa
+{
+
+constexpr int mpol_bind = 2;
+constexpr int mpol_f_node = 1 << 0;
+constexpr int mpol_f_addr = 1 << 1;
+constexpr unsigned mpol_mf_strict = 1 << 0;
+
+constexpr std::size_t max_nodes = 8;
+
+using node_mask = unsigned long;
+static_assert(sizeof(node_mask) * 8 >= max_nodes, "one bit per node");
+
+// Pages of [p, p + bytes) come from the node only, before they are faulted in.
+inline bool bind(void* p, std::size_t bytes, std::size_t node)
+{
+    const node_mask mask = node_mask{1} << node;
+
+    return ::syscall(SYS_mbind, p, bytes, mpol_bind, &mask, sizeof(mask) * 8, mpol_mf_strict) == 0;
+}
+
+// Node the page at p is on (after it is faulted in), -1 if unknown.
+inline int node_of(const void* p)
+{
+    int node = -1;
+
+    if (::syscall(SYS_get_mempolicy, &node, nullptr, 0, p, mpol_f_node | mpol_f_addr) != 0) return -1;
+
+    return node;
+}
+
+// "0-3,8,10-11" -> 0 1 2 3 8 10 11
+inline std::vector<std::size_t> parse_list(const std::string& s)
+{
+    std::vector<std::size_t> r;
+    std::istringstream in{s};
+
+    for (std::string range; std::getline(in, range, ','); )
+    {
+        if (range.empty()) continue;
+
+        const auto dash = range.find('-');
+        const std::size_t first = std::stoul(range.substr(0, dash));
+        const std::size_t last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+
+        for (std::size_t i = first; i <= last; ++i) r.push_back(i);
+    }
+
+    return r;
+}
+
+inline std::string read_line(const std::string& path)
+{
+    std::ifstream in{path};
+    std::string line;
+
+    std::getline(in, line);
+
+    return line;
+}
+
+
+// Nodes, the CPUs of each and, per node, all the nodes nearest first.
+struct topology
+{
+    std::size_t nodes = 1;
+    std::vector<std::size_t> node_of_cpu;
+    std::array<std::vector<std::size_t>, max_nodes> cpus;
+    std::array<std::vector<std::size_t>, max_nodes> nearest;
+    bool simulated = false;
+
+    std::size_t current_node() const noexcept
+    {
+        const int cpu = ::sched_getcpu();
+
+        return (cpu < 0 || static_cast<std::size_t>(cpu) >= node_of_cpu.size()) ? 0 : node_of_cpu[cpu];
+    }
+
+    // From sysfs; a single node if there is none.
+    static topology detect()
+    {
+        topology t;
+
+        const std::size_t cpus = static_cast<std::size_t>(::sysconf(_SC_NPROCESSORS_CONF));
+        const auto online = parse_list(read_line("/sys/devices/system/node/online"));
+
+        t.node_of_cpu.assign(cpus, 0);
+
+        if (online.empty() || online.back() >= max_nodes)
+        {
+            for (std::size_t c = 0; c < cpus; ++c) t.cpus[0].push_back(c);
+
+            t.nearest[0] = {0};
+
+            return t;
+        }
+
+        t.nodes = online.back() + 1;  // offline nodes in between get no CPUs and no memory
+
+        for (std::size_t n : online)
+        {
+            const std::string dir = "/sys/devices/system/node/node" + std::to_string(n);
+
+            for (std::size_t c : parse_list(read_line(dir + "/cpulist"))) if (c < cpus) { t.cpus[n].push_back(c); t.node_of_cpu[c] = n; }
+
+            std::istringstream distances{read_line(dir + "/distance")};
+            std::vector<std::pair<int, std::size_t>> by_distance;
+            int d = 0;
+
+            for (std::size_t other = 0; distances >> d; ++other) if (std::find(online.begin(), online.end(), other) != online.end()) by_distance.push_back({d, other});
+
+            std::sort(by_distance.begin(), by_distance.end());
+
+            for (const auto& [distance, other] : by_distance) t.nearest[n].push_back(other);
+        }
+
+        return t;
+    }
+
+    // The CPUs dealt round-robin between the nodes; memory is not bound to them.
+    static topology simulate(std::size_t nodes)
+    {
+        topology t;
+
+        const std::size_t cpus = static_cast<std::size_t>(::sysconf(_SC_NPROCESSORS_CONF));
+
+        t.nodes = nodes;
+        t.simulated = true;
+
+        for (std::size_t c = 0; c < cpus; ++c)
+        {
+            t.node_of_cpu.push_back(c % nodes);
+            t.cpus[c % nodes].push_back(c);
+        }
+
+        for (std::size_t n = 0; n < nodes; ++n) for (std::size_t i = 0; i < nodes; ++i) t.nearest[n].push_back((n + i) % nodes);
+
+        return t;
+    }
+};
+
+}  // namespace numa
+
+
+// How the region of a node got its pages.
+enum class placement : std::uint8_t
+{
+    bound,  // mbind: pages from the node only
+    first_touch,  // faulted in by a thread running on the node
+    anywhere  // neither worked (no such node, no CPUs on it)
+};
+
+std::ostream& operator<<(std::ostream& os, placement p)
+{
+    switch (p)
+    {
+        case placement::bound: return os << "bound";
+        case placement::first_touch: return os << "first touch";
+        case placement::anywhere: return os << "anywhere";
+    }
+
+    return os;
+}
+
+// Per node: occupies of callers on the node that went elsewhere, and the
+// node's own region. Local occupies count nothing, they are the fast path.
+struct node_stats
+{
+    std::size_t remote = 0;  // served from another node
+    std::size_t failed = 0;  // Nothing: all nodes full
+    std::size_t occupied = 0;  // objects of this node's region in use, a snapshot
+    std::size_t capacity = 0;
+    placement placed = placement::anywhere;
+    int page_node = -1;  // node of the region's first page as reported by the kernel
+};
+
+
+// pool_of<T> (coliru/3f1f7afeb51db795.cpp) with one region per NUMA node.
+// occupy serves the caller's node first and the other nodes nearest first
+// when it is full; release returns the object to the region it is from.
+// Every region is a lock-free stack of indices with a tagged head.
+template<class T>
+class numa_pool_of
+{
+    static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+    static constexpr std::uint64_t pack(std::uint32_t index, std::uint32_t tag) { return (std::uint64_t{tag} << 32) | index; }
+    static constexpr std::uint32_t index_of(std::uint64_t h) { return static_cast<std::uint32_t>(h); }
+    static constexpr std::uint32_t tag_of(std::uint64_t h) { return static_cast<std::uint32_t>(h >> 32); }
+
+    enum : std::uint8_t { is_free, is_occupied };
+
+    struct meta
+    {
+        std::atomic<std::uint32_t> next;
+        std::atomic<std::uint8_t> state;
+    };
+
+    struct storage
+    {
+        alignas(T) unsigned char bytes[sizeof(T)];
+    };
+
+    struct region
+    {
+        storage* slots = nullptr;
+        meta* metas = nullptr;
+        std::uint32_t size = 0;
+        placement placed = placement::anywhere;
+
+        alignas(64) std::atomic<std::uint64_t> head{pack(none, 0)};
+        alignas(64) std::atomic<std::size_t> remote{0};
+        std::atomic<std::size_t> failed{0};
+
+        bool owns(const storage* s) const noexcept { return (s >= slots) && (s < slots + size); }
+
+        std::uint32_t pop()
+        {
+            std::uint64_t h = head.load(std::memory_order_acquire);
+
+            while (index_of(h) != none)
+            {
+                const std::uint32_t next = metas[index_of(h)].next.load(std::memory_order_relaxed);
+
+                if (head.compare_exchange_weak(h, pack(next, tag_of(h) + 1), std::memory_order_acquire, std::memory_order_acquire)) return index_of(h);
+            }
+
+            return none;
+        }
+
+        void push(std::uint32_t i)
+        {
+            std::uint64_t h = head.load(std::memory_order_relaxed);
+
+            do
+            {
+                metas[i].next.store(index_of(h), std::memory_order_relaxed);
+            }
+            while ( ! head.compare_exchange_weak(h, pack(i, tag_of(h) + 1), std::memory_order_release, std::memory_order_relaxed));
+        }
+    };
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "tagged head must be lock-free");
+    static_assert(alignof(T) <= 4096, "objects are placed at the start of the region");
+
+ public:
+
+    // capacity objects on every node of t.
+    static void init(std::size_t capacity, numa::topology t = numa::topology::detect())
+    {
+        if (nodes != 0) fatal("numa_pool_of initialised twice");
+        if (capacity == 0 || capacity >= none) fatal("numa_pool_of capacity out of range");
+        if (t.nodes == 0 || t.nodes > numa::max_nodes) fatal("numa_pool_of node count out of range");
+
+        topo = std::move(t);
+
+        for (std::size_t n = 0; n < topo.nodes; ++n) map(regions[n], n, capacity);
+
+        nodes = topo.nodes;
+    }
+
+    template<class... As>
+    static maybe<T> occupy(As&&... args)
+    {
+        if (nodes == 0) fatal("numa_pool_of not initialised");
+
+        const std::size_t here = topo.current_node();
+
+        for (std::size_t n : topo.nearest[here])
+        {
+            region& r = regions[n];
+            const std::uint32_t i = r.pop();
+
+            if (i == none) continue;
+
+            r.metas[i].state.store(is_occupied, std::memory_order_relaxed);
+
+            T* p = nullptr;
+
+            try
+            {
+                p = new (r.slots + i) T(std::forward<As>(args)...);
+            }
+            catch (...)
+            {
+                r.metas[i].state.store(is_free, std::memory_order_relaxed);
+                r.push(i);
+                throw;
+            }
+
+            if (n != here) regions[here].remote.fetch_add(1, std::memory_order_relaxed);
+
+            return maybe<T>{p};
+        }
+
+        regions[here].failed.fetch_add(1, std::memory_order_relaxed);
+
+        return maybe<T>{};
+    }
+
+    // Back to the region it is from, m becomes Nothing; releasing Nothing has no effect.
+    static void release(maybe<T>& m)
+    {
+        if ( ! m) return;
+
+        const auto* s = reinterpret_cast<const storage*>(m.get());
+
+        for (std::size_t n = 0; n < nodes; ++n)
+        {
+            region& r = regions[n];
+
+            if ( ! r.owns(s)) continue;
+
+            const auto i = static_cast<std::uint32_t>(s - r.slots);
+
+            if (r.metas[i].state.exchange(is_free, std::memory_order_acq_rel) != is_occupied) fatal("numa_pool_of object released twice");
+
+            m->~T();
+            m = maybe<T>{};
+
+            r.push(i);
+
+            return;
+        }
+
+        fatal("numa_pool_of released an object not from the pool");
+    }
+
+    static node_stats stats(std::size_t node)
+    {
+        const region& r = regions[node];
+
+        node_stats s;
+
+        s.remote = r.remote.load(std::memory_order_relaxed);
+        s.failed = r.failed.load(std::memory_order_relaxed);
+        for (std::uint32_t i = 0; i < r.size; ++i) s.occupied += (r.metas[i].state.load(std::memory_order_relaxed) == is_occupied);
+
+        s.capacity = r.size;
+        s.placed = r.placed;
+        s.page_node = numa::node_of(r.slots);
+
+        return s;
+    }
+
+    static std::size_t node_count() noexcept { return nodes; }
+    static const numa::topology& topology() noexcept { return topo; }
+
+ private:
+
+    // Binds the region to the node before its pages are faulted in; if the
+    // kernel refuses, faults them in from a thread on the node's CPUs.
+    static void map(region& r, std::size_t node, std::size_t capacity)
+    {
+        const std::size_t objects = capacity * sizeof(storage);
+        const std::size_t meta_at = (objects + alignof(meta) - 1) / alignof(meta) * alignof(meta);
+        const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        const std::size_t bytes = (meta_at + capacity * sizeof(meta) + page - 1) / page * page;
+
+        void* base = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (base == MAP_FAILED) fatal("numa_pool_of region cannot be mapped");
+
+        auto touch = [base, bytes, page] { for (std::size_t b = 0; b < bytes; b += page) static_cast<volatile unsigned char*>(base)[b] = 0; };
+
+        if ( ! topo.simulated && numa::bind(base, bytes, node))
+        {
+            r.placed = placement::bound;
+            touch();
+        }
+        else if ( ! topo.simulated && ! topo.cpus[node].empty())
+        {
+            // first touch: the faulting CPU's node provides the page
+            std::thread toucher{[&]
+            {
+                cpu_set_t on_node;
+
+                CPU_ZERO(&on_node);
+
+                for (std::size_t c : topo.cpus[node]) CPU_SET(c, &on_node);
+
+                r.placed = (::sched_setaffinity(0, sizeof(on_node), &on_node) == 0) ? placement::first_touch : placement::anywhere;
+                touch();
+            }};
+
+            toucher.join();
+        }
+        else
+        {
+            r.placed = placement::anywhere;
+            touch();
+        }
+
+        r.slots = static_cast<storage*>(base);
+        r.metas = reinterpret_cast<meta*>(static_cast<unsigned char*>(base) + meta_at);
+        r.size = static_cast<std::uint32_t>(capacity);
+
+        for (std::uint32_t i = 0; i < r.size; ++i) new (r.metas + i) meta{{i + 1 < r.size ? i + 1 : none}, {is_free}};
+
+        r.head.store(pack(0, 0));
+    }
+
+    inline static numa::topology topo;
+    inline static std::array<region, numa::max_nodes> regions;
+    inline static std::size_t nodes = 0;
+};
+
+
+
+// ---
+
+
+struct route
+{
+    explicit route(std::uint64_t k = 0) : key{k} {}
+
+    std::uint64_t key;
+    std::array<std::uint64_t, 7> hops{};
+};
+
+// Separate pool, same layout, on a simulated topology.
+struct simulated_route : route { using route::route; };
+
+
+template<class Pool>
+void report(std::ostream& os)
+{
+    for (std::size_t n = 0; n < Pool::node_count(); ++n)
+    {
+        const node_stats s = Pool::stats(n);
+
+        os << "  node " << n << ": " << s.placed << " (pages on node " << s.page_node << "), " << s.occupied << '/' << s.capacity << " occupied; callers here: " << s.remote << " remote hits, " << s.failed << " failed\n";
+    }
+}
+
+template<class F>
+double ms(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    f();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Every thread occupies and releases batch objects at a time.
+template<class Occupy, class Release>
+double churn(std::size_t threads, std::size_t rounds, Occupy occupy, Release release)
+{
+    return ms([&]
+    {
+        std::vector<std::thread> workers;
+
+        for (std::size_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&occupy, &release, rounds]
+            {
+                constexpr std::size_t batch = 16;
+
+                for (std::size_t i = 0; i < rounds / batch; ++i)
+                {
+                    std::array<decltype(occupy()), batch> held;
+
+                    for (auto& h : held) h = occupy();
+                    for (auto& h : held) release(h);
+                }
+            });
+        }
+
+        for (auto& w : workers) w.join();
+    });
+}
+
+
+
+int main()
+{
+    constexpr std::size_t capacity = 1 << 16;  // per node
+
+    numa_pool_of<route>::init(capacity);
+
+    std::cout << numa_pool_of<route>::node_count() << " node(s) detected, " << std::thread::hardware_concurrency() << " cores\n";
+
+    // two nodes simulated on whatever there is: the caller's node fills up, the rest is remote
+    {
+        using pool = numa_pool_of<simulated_route>;
+
+        pool::init(1024, numa::topology::simulate(2));
+
+        std::vector<maybe<simulated_route>> held;
+
+        for (maybe<simulated_route> m; (m = pool::occupy(held.size())); ) held.push_back(m);
+
+        std::cout << "simulated 2 nodes, occupied all " << held.size() << ":\n";
+        report<pool>(std::cout);
+
+        for (auto& m : held) pool::release(m);
+    }
+
+    constexpr std::size_t rounds = 4'000'000;
+
+    for (std::size_t threads : {1, 4})
+    {
+        const double plain = churn(threads, rounds, [] { return new route; }, [](route* p) { delete p; });
+        const double pooled = churn(threads, rounds, [] { return numa_pool_of<route>::occupy(); }, [](maybe<route>& m) { numa_pool_of<route>::release(m); });
+
+        std::cout << threads << " thread(s) x " << rounds << ": new/delete " << plain << " ms, numa_pool_of " << pooled << " ms\n";
+    }
+
+    std::cout << "detected:\n";
+    report<numa_pool_of<route>>(std::cout);
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+1 node(s) detected, 1 cores
+simulated 2 nodes, occupied all 2048:
+  node 0: anywhere (pages on node 0), 1024/1024 occupied; callers here: 1024 remote hits, 1 failed
+  node 1: anywhere (pages on node 0), 1024/1024 occupied; callers here: 0 remote hits, 0 failed
+1 thread(s) x 4000000: new/delete 149.671 ms, numa_pool_of 156.12 ms
+4 thread(s) x 4000000: new/delete 627.394 ms, numa_pool_of 701.354 ms
+detected:
+  node 0: bound (pages on node 0), 0/65536 occupied; callers here: 0 remote hits, 0 failed
+*/
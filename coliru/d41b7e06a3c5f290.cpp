@@ -0,0 +1,828 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout
+
+#include <algorithm>  // for_each, max
+#include <cassert>  // assert
+#include <chrono>  // steady_clock
+#include <cstddef>  // size_t, ptrdiff_t
+#include <cstdint>  // uint32_t, uint64_t
+#include <cstdio>  // FILE, fdopen, fwrite, remove
+#include <cstdlib>  // exit, mkstemp
+#include <cstring>  // memcpy, memset
+#include <limits>  // numeric_limits
+#include <memory>  // unique_ptr
+#include <optional>  // optional
+#include <string>  // string, to_string
+#include <string_view>  // string_view
+#include <system_error>  // system_error, errno
+#include <type_traits>  // enable_if, is_convertible
+#include <unordered_map>  // unordered_map
+#include <utility>  // move, exchange
+#include <vector>  // vector
+
+#include <fcntl.h>  // open
+#include <sys/mman.h>  // mmap, munmap, madvise
+#include <sys/resource.h>  // getrusage
+#include <sys/stat.h>  // fstat
+#include <sys/wait.h>  // wait
+#include <unistd.h>  // close, fork, pipe
+
+#if defined(__AVX2__) && defined(__PCLMUL__)
+#include <immintrin.h>  // _mm256_*, _mm_clmulepi64_si128
+#endif
+
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/iterator/iterator_categories.hpp>
+
+
+
+class json_node_type
+{
+    template<class T>
+    class iter
+      : public boost::iterator_facade<iter<T>, T, boost::random_access_traversal_tag>
+    {
+        struct enabler {};
+        using size_type = typename T::size_type;
+
+     public:
+        // default-constructible and assignable, as required by random access iterators
+        iter() = default;
+
+        explicit iter(T& _n, size_type _i = 0)
+          : n{&_n}, i{_i}
+        {}
+
+        template<class U>
+        iter(const iter<U>& other
+          , std::enable_if_t<std::is_convertible<U*, T*>::value, enabler> = enabler{})
+          : n{other.n}, i{other.i}
+        {}
+
+     private:
+        friend class boost::iterator_core_access;
+
+        template<class> friend class iter;
+
+        template<class U>
+        bool equal(const iter<U>& other) const
+        {
+            return (this->i == other.i) && (this->n == other.n);
+        }
+
+        void increment()
+        {
+            assert(i < n->size());
+            ++i;
+        }
+
+        void decrement()
+        {
+            assert(i > 0);
+            --i;
+        }
+
+        void advance(std::ptrdiff_t d)
+        {
+            assert((static_cast<std::ptrdiff_t>(i) + d >= 0)
+                && (static_cast<std::ptrdiff_t>(i) + d <= static_cast<std::ptrdiff_t>(n->size())));
+            i += d;
+        }
+
+        template<class U>
+        std::ptrdiff_t distance_to(const iter<U>& other) const
+        {
+            assert(this->n == other.n);
+
+            return static_cast<std::ptrdiff_t>(other.i) - static_cast<std::ptrdiff_t>(this->i);
+        }
+
+        T& dereference() const
+        {
+            assert(i < n->size());
+
+            return (i == 0) ? *n : n->tail[i - 1];
+        }
+
+        T* n = nullptr;
+        size_type i = 0;
+    };
+
+ public:
+
+    using tail_type = std::vector<json_node_type>;
+    using size_type = tail_type::size_type;
+    using iterator = iter<json_node_type>;
+    using const_iterator = iter<const json_node_type>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    json_node_type() = default;
+    explicit json_node_type(std::string d) : data{std::move(d)} {}
+
+    size_type size() const noexcept { return 1 + tail.size(); }
+
+    iterator begin() noexcept { return iterator{*this, 0}; }
+    const_iterator begin() const noexcept { return const_iterator{*this, 0}; }
+
+    iterator end() noexcept { return iterator{*this, size()}; }
+    const_iterator end() const noexcept { return const_iterator{*this, size()}; }
+
+    const_iterator cbegin() const noexcept { return const_iterator{*this, 0}; }
+    const_iterator cend() const noexcept { return const_iterator{*this, size()}; }
+
+    reverse_iterator rbegin() noexcept { return reverse_iterator{end()}; }
+    const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator{end()}; }
+
+    reverse_iterator rend() noexcept { return reverse_iterator{begin()}; }
+    const_reverse_iterator rend() const noexcept { return const_reverse_iterator{begin()}; }
+
+    const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+    const_reverse_iterator crend() const noexcept { return rend(); }
+
+    /** NOTE: Head is not stored together with the tail, so that only tail is contiguous. */
+    json_node_type* tail_data() noexcept { return tail.data(); }
+    const json_node_type* tail_data() const noexcept { return tail.data(); }
+
+    void push_back(json_node_type&& n) { tail.push_back(std::forward<json_node_type>(n)); }
+    void push_back(const json_node_type& n) { tail.push_back(n); }
+
+    /** NOTE: Resizes into @c size equal to @c n+1 value. */
+    void resize(size_type n) { tail.resize(n); }
+
+    const std::string& value() const noexcept { return data; }
+
+ private:
+    std::string data;
+    tail_type tail;
+};
+
+
+
+// ------------------------------------
+
+
+// Stage 1: find positions of all the structural characters ({}[]:,), of the
+// opening quotes and of the first characters of the other scalars, 64 bytes at once.
+// Based on the simdjson approach (Langdale, Lemire: "Parsing Gigabytes of JSON per Second").
+class structural_index
+{
+    struct block
+    {
+        std::uint64_t quote;
+        std::uint64_t backslash;
+        std::uint64_t op;  // { } [ ] : ,
+        std::uint64_t whitespace;
+    };
+
+#if defined(__AVX2__) && defined(__PCLMUL__)
+    static std::uint64_t mask(__m256i lo, __m256i hi)
+    {
+        const auto l = static_cast<std::uint32_t>(_mm256_movemask_epi8(lo));
+        const auto h = static_cast<std::uint32_t>(_mm256_movemask_epi8(hi));
+
+        return (std::uint64_t{h} << 32) | l;
+    }
+
+    // Table lookup by the low nibble: a character is a whitespace (or an operator)
+    // if it equals the table entry selected by its own low nibble.
+    static block classify(const char* p)
+    {
+        const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+
+        const __m256i ws = _mm256_setr_epi8(' ', 100, 100, 100, 17, 100, 113, 2, 100, '\t', '\n', 112, 100, '\r', 100, 100
+                                          , ' ', 100, 100, 100, 17, 100, 113, 2, 100, '\t', '\n', 112, 100, '\r', 100, 100);
+        const __m256i op = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', '{', ',', '}', 0, 0
+                                          , 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', '{', ',', '}', 0, 0);
+        const __m256i lower = _mm256_set1_epi8(0x20);  // maps [ ] into { }
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i backslash = _mm256_set1_epi8('\\');
+
+        return block
+        {
+            mask(_mm256_cmpeq_epi8(lo, quote), _mm256_cmpeq_epi8(hi, quote))
+          , mask(_mm256_cmpeq_epi8(lo, backslash), _mm256_cmpeq_epi8(hi, backslash))
+          , mask(_mm256_cmpeq_epi8(_mm256_shuffle_epi8(op, lo), _mm256_or_si256(lo, lower))
+               , _mm256_cmpeq_epi8(_mm256_shuffle_epi8(op, hi), _mm256_or_si256(hi, lower)))
+          , mask(_mm256_cmpeq_epi8(_mm256_shuffle_epi8(ws, lo), lo)
+               , _mm256_cmpeq_epi8(_mm256_shuffle_epi8(ws, hi), hi))
+        };
+    }
+
+    // Bit i of the result is the XOR of bits 0..i of x: "inside of a quoted string".
+    static std::uint64_t prefix_xor(std::uint64_t x)
+    {
+        const __m128i r = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<long long>(x)), _mm_set1_epi8(-1), 0);
+
+        return static_cast<std::uint64_t>(_mm_cvtsi128_si64(r));
+    }
+#else
+    static block classify(const char* p)
+    {
+        block b{};
+
+        for (std::uint64_t i = 0; i < 64; ++i)
+        {
+            const char c = p[i];
+
+            b.quote |= std::uint64_t{c == '"'} << i;
+            b.backslash |= std::uint64_t{c == '\\'} << i;
+            b.op |= std::uint64_t{(c == '{') || (c == '}') || (c == '[') || (c == ']') || (c == ':') || (c == ',')} << i;
+            b.whitespace |= std::uint64_t{(c == ' ') || (c == '\n') || (c == '\t') || (c == '\r')} << i;
+        }
+
+        return b;
+    }
+
+    static std::uint64_t prefix_xor(std::uint64_t x)
+    {
+        for (unsigned shift = 1; shift < 64; shift *= 2) x ^= x << shift;
+
+        return x;
+    }
+#endif
+
+    // Characters preceded by an odd number of backslashes.
+    std::uint64_t escaped(std::uint64_t backslash)
+    {
+        constexpr std::uint64_t even_bits = 0x5555555555555555;
+
+        backslash &= ~prev_escaped;
+
+        const std::uint64_t follows_escape = (backslash << 1) | prev_escaped;
+        const std::uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+
+        std::uint64_t even_starts = 0;
+        prev_escaped = __builtin_add_overflow(odd_starts, backslash, &even_starts);
+
+        return (even_bits ^ (even_starts << 1)) & follows_escape;
+    }
+
+    void step(const char* p, std::uint32_t offset)
+    {
+        const block b = classify(p);
+
+        const std::uint64_t quote = b.quote & ~escaped(b.backslash);
+        const std::uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+
+        prev_in_string = static_cast<std::uint64_t>(static_cast<std::int64_t>(in_string) >> 63);
+
+        // quotes end a scalar, so that a token right after a closing quote gets its own position
+        const std::uint64_t scalar = ~(b.op | b.whitespace | quote);
+        const std::uint64_t follows_scalar = (scalar << 1) | prev_scalar;
+
+        prev_scalar = scalar >> 63;
+
+        const std::uint64_t opening = quote & in_string;
+        const std::uint64_t string_tail = in_string ^ quote;  // inside and the closing quote
+        std::uint64_t structurals = (b.op | opening | (scalar & ~follows_scalar)) & ~string_tail;
+
+        // Branch-light flattening: 8 positions are written at once, even if fewer
+        // bits are set; the buffer has room for that, and count tells what is valid.
+        const auto n = static_cast<std::size_t>(__builtin_popcountll(structurals));
+        std::uint32_t* out = positions.get() + count;
+
+        while (structurals)
+        {
+            for (int k = 0; k < 8; ++k)
+            {
+                out[k] = offset + static_cast<std::uint32_t>(__builtin_ctzll(structurals | (std::uint64_t{1} << 63)));
+                structurals &= structurals - 1;
+            }
+
+            out += 8;
+        }
+
+        count += n;
+    }
+
+ public:
+    // false on unterminated string, or a source that 32-bit positions cannot address
+    bool build(std::string_view s)
+    {
+        if (s.size() > std::numeric_limits<std::uint32_t>::max() - 64) return false;
+
+        if (capacity < s.size() + 64)  // at most one position per byte, plus the overrun
+        {
+            capacity = s.size() + 64;
+            positions.reset(new std::uint32_t[capacity]);  // not initialised on purpose
+        }
+
+        count = 0;
+        prev_escaped = prev_in_string = prev_scalar = 0;
+
+        std::size_t i = 0;
+
+        for (; i + 64 <= s.size(); i += 64) step(s.data() + i, static_cast<std::uint32_t>(i));
+
+        if (i < s.size())  // tail padded with whitespace
+        {
+            char last[64];
+
+            std::memset(last, ' ', sizeof(last));
+            std::memcpy(last, s.data() + i, s.size() - i);
+
+            step(last, static_cast<std::uint32_t>(i));
+        }
+
+        return prev_in_string == 0;
+    }
+
+    std::size_t size() const noexcept { return count; }
+
+    std::uint32_t operator[] (std::size_t k) const noexcept { return positions[k]; }
+
+ private:
+    std::unique_ptr<std::uint32_t[]> positions;
+    std::size_t capacity = 0;
+    std::size_t count = 0;
+
+    std::uint64_t prev_escaped = 0;
+    std::uint64_t prev_in_string = 0;
+    std::uint64_t prev_scalar = 0;
+};
+
+
+
+// ---
+
+
+// Read-only view of a whole file, its pages are read in when touched.
+class mapped_file
+{
+ public:
+    explicit mapped_file(const char* path)
+    {
+        const int fd = ::open(path, O_RDONLY);
+
+        if (fd < 0) throw std::system_error{errno, std::generic_category(), path};
+
+        struct stat st{};
+
+        if (fstat(fd, &st) != 0)
+        {
+            const int error = errno;
+
+            ::close(fd);
+
+            throw std::system_error{error, std::generic_category(), path};
+        }
+
+        size = static_cast<std::size_t>(st.st_size);
+
+        void* p = (size > 0) ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+        const int error = errno;
+
+        ::close(fd);
+
+        if (p == MAP_FAILED) throw std::system_error{error, std::generic_category(), path};
+
+        data = static_cast<const char*>(p);
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator= (const mapped_file&) = delete;
+
+    ~mapped_file() { if (data) munmap(const_cast<char*>(data), size); }
+
+    std::string_view view() const noexcept { return {data, size}; }
+
+ private:
+    const char* data = nullptr;
+    std::size_t size = 0;
+};
+
+
+// Only the structural index is built up front, plus the position of the matching
+// closing bracket for every container (thus subtrees are skipped in O(1)).
+// Nodes are materialised into json_node_type on the first request, and cached;
+// the cache makes materialisation not thread-safe. The source must outlive the document.
+class lazy_document
+{
+ public:
+
+    // Handle with the forward traversal interface of json_node_type:
+    // element 0 is the node itself, elements 1..n are its children.
+    class lazy_node
+    {
+        template<class T>
+        class iter
+          : public boost::iterator_facade<iter<T>, T, boost::forward_traversal_tag, T>
+        {
+         public:
+            iter(T _n, std::uint32_t _k) : n{_n}, k{_k} {}
+
+         private:
+            friend class boost::iterator_core_access;
+
+            bool equal(const iter& other) const { return (k == other.k) && (n.doc == other.n.doc); }
+
+            void increment() { k = (k == n.k) ? (k + 1) : n.doc->next(k); }
+
+            T dereference() const { return (k == n.k) ? n : T{n.doc, k}; }
+
+            T n;
+            std::uint32_t k;  // position in the structural index
+        };
+
+     public:
+
+        using iterator = iter<lazy_node>;
+        using const_iterator = iter<lazy_node>;
+
+        lazy_node(const lazy_document* d, std::uint32_t k) : doc{d}, k{k} {}
+
+        iterator begin() const noexcept { return iterator{*this, k}; }
+        iterator end() const noexcept { return iterator{*this, doc->children_end(k)}; }
+
+        const_iterator cbegin() const noexcept { return begin(); }
+        const_iterator cend() const noexcept { return end(); }
+
+        std::string_view value() const { return doc->token(k); }
+
+        // Value of the member named key (escapes are compared as they are).
+        std::optional<lazy_node> find(std::string_view key) const
+        {
+            if (value() != "{") return std::nullopt;
+
+            for (auto it = std::next(begin()); it != end(); ++it)
+            {
+                const bool found = (it->value() == key);
+
+                if (++it == end()) break;
+                if (found) return *it;
+            }
+
+            return std::nullopt;
+        }
+
+        std::optional<lazy_node> at(std::size_t i) const
+        {
+            if (value() != "[") return std::nullopt;
+
+            auto it = std::next(begin());
+
+            for (; (it != end()) && (i > 0); --i) ++it;
+
+            return (it != end()) ? std::optional<lazy_node>{*it} : std::nullopt;
+        }
+
+        const json_node_type& materialize() const { return doc->materialize(k); }
+
+     private:
+        const lazy_document* doc;
+        std::uint32_t k;
+    };
+
+
+    // false on unterminated string, brackets that do not match, punctuation out of
+    // place (e.g. ["a"x] or [1 2]), or a source of 4 GiB or more
+    bool build(std::string_view s)
+    {
+        enum class expect { value, value_or_close, key, key_or_close, colon, next };
+
+        src = s;
+        cache.clear();
+
+        if ( ! idx.build(s) || (idx.size() == 0)) return false;
+
+        match.resize(idx.size());
+
+        std::vector<std::uint32_t> open;
+        expect state = expect::value;
+
+        const auto is_value = [&state] { return (state == expect::value) || (state == expect::value_or_close); };
+        const auto is_key = [&state] { return (state == expect::key) || (state == expect::key_or_close); };
+
+        for (std::uint32_t k = 0; k < idx.size(); ++k)
+        {
+            const char c = s[idx[k]];
+
+            switch (c)
+            {
+                case '{':
+                case '[':
+                    if ( ! is_value()) return false;
+
+                    open.push_back(k);
+                    state = (c == '{') ? expect::key_or_close : expect::value_or_close;
+                    break;
+
+                case '}':
+                case ']':
+                {
+                    const bool empty = (state == ((c == '}') ? expect::key_or_close : expect::value_or_close));
+
+                    if (( ! empty && (state != expect::next)) || open.empty() || (s[idx[open.back()]] != ((c == '}') ? '{' : '['))) return false;
+
+                    match[open.back()] = k;
+                    open.pop_back();
+                    state = expect::next;
+                    break;
+                }
+
+                case ',':
+                    if ((state != expect::next) || open.empty()) return false;
+
+                    state = (s[idx[open.back()]] == '{') ? expect::key : expect::value;
+                    break;
+
+                case ':':
+                    if (state != expect::colon) return false;
+
+                    state = expect::value;
+                    break;
+
+                case '"':
+                    if ( ! is_value() && ! is_key()) return false;
+
+                    state = is_key() ? expect::colon : expect::next;
+                    break;
+
+                default:  // number, true, false, null
+                    if ( ! is_value()) return false;
+
+                    state = expect::next;
+                    break;
+            }
+        }
+
+        return open.empty() && (state == expect::next);
+    }
+
+    lazy_node root() const { return lazy_node{this, 0}; }
+
+    std::size_t index_bytes() const noexcept { return idx.size() * 2 * sizeof(std::uint32_t); }
+
+    std::size_t materialised() const noexcept { return nodes; }
+
+ private:
+    bool is_container(std::uint32_t k) const { return (src[idx[k]] == '{') || (src[idx[k]] == '['); }
+
+    std::uint32_t children_end(std::uint32_t k) const { return is_container(k) ? match[k] : (k + 1); }
+
+    // Position of the next sibling, or of the parent's closing bracket.
+    std::uint32_t next(std::uint32_t k) const
+    {
+        std::uint32_t j = is_container(k) ? (match[k] + 1) : (k + 1);
+
+        if ((j < idx.size()) && ((src[idx[j]] == ',') || (src[idx[j]] == ':'))) ++j;
+
+        return j;
+    }
+
+    // Strings without quotes, with escapes left as they are; containers as "{" or "[".
+    std::string_view token(std::uint32_t k) const
+    {
+        const std::size_t p = idx[k];
+
+        if (is_container(k)) return src.substr(p, 1);
+
+        if (src[p] == '"')
+        {
+            std::size_t e = p + 1;
+
+            for (;;)
+            {
+                e = src.find('"', e);
+
+                std::size_t b = e;
+                while (src[b - 1] == '\\') --b;
+
+                if (((e - b) % 2) == 0) break;
+
+                ++e;
+            }
+
+            return src.substr(p + 1, e - p - 1);
+        }
+
+        std::size_t e = (k + 1 < idx.size()) ? idx[k + 1] : src.size();
+
+        while ((src[e - 1] == ' ') || (src[e - 1] == '\n') || (src[e - 1] == '\t') || (src[e - 1] == '\r')) --e;
+
+        return src.substr(p, e - p);
+    }
+
+    json_node_type make(std::uint32_t k) const
+    {
+        json_node_type n{std::string{token(k)}};
+        ++nodes;
+
+        for (std::uint32_t c = k + 1, end = children_end(k); c < end; c = next(c)) n.push_back(make(c));
+
+        return n;
+    }
+
+    const json_node_type& materialize(std::uint32_t k) const
+    {
+        auto it = cache.find(k);
+
+        if (it == cache.end()) it = cache.emplace(k, make(k)).first;
+
+        return it->second;
+    }
+
+    std::string_view src;
+    structural_index idx;
+    std::vector<std::uint32_t> match;  // for containers: position of the closing bracket
+
+    mutable std::unordered_map<std::uint32_t, json_node_type> cache;
+    mutable std::size_t nodes = 0;
+};
+
+
+
+// ---
+
+
+template<class Node>
+std::size_t total_length(const Node& n)
+{
+    std::size_t r = 0;
+    bool head = true;
+
+    std::for_each(std::cbegin(n), std::cend(n), [&r, &head](const auto& x)
+    {
+        if (head) { r += x.value().size(); head = false; }
+        else r += total_length(x);
+    });
+
+    return r;
+}
+
+// Takes over fd.
+void write_payload(int fd, std::size_t records)
+{
+    std::FILE* f = ::fdopen(fd, "w");
+
+    if ( ! f) std::exit(1);
+
+    std::fputs("[", f);
+
+    for (std::size_t i = 0; i < records; ++i)
+    {
+        const std::string s = (i ? "," : "")
+                            + std::string{R"({"id":)"} + std::to_string(i)
+                            + R"(,"name":"user)" + std::to_string(i)
+                            + R"(","active":true,"tags":["a","bb","ccc"],"geo":{"lat":52.2297,"lon":21.0122}})";
+
+        std::fwrite(s.data(), 1, s.size(), f);
+    }
+
+    std::fputs("]", f);
+    std::fclose(f);
+}
+
+template<class F>
+double ms(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    f();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+struct measurement
+{
+    double index_ms = 0;
+    double access_ms = 0;
+    std::size_t index_bytes = 0;
+    std::size_t nodes = 0;
+    std::size_t length = 0;
+    long peak_rss_kb = 0;
+};
+
+// Runs in a child process, so that peak RSS is not shared between the runs.
+template<class F>
+measurement measure(const char* path, F access)
+{
+    int fd[2];
+
+    if (pipe(fd) != 0) std::exit(1);
+
+    std::cout.flush();
+
+    if (fork() == 0)
+    {
+        measurement m;
+
+        mapped_file file{path};
+        lazy_document doc;
+        bool ok = false;
+
+        m.index_ms = ms([&] { ok = doc.build(file.view()); });
+
+        if ( ! ok) std::exit(1);
+
+        m.access_ms = ms([&] { m.length = access(doc.root()); });
+        m.index_bytes = doc.index_bytes();
+        m.nodes = doc.materialised();
+
+        rusage u{};
+        getrusage(RUSAGE_SELF, &u);
+        m.peak_rss_kb = u.ru_maxrss;
+
+        [[maybe_unused]] auto n = write(fd[1], &m, sizeof(m));
+        std::exit(0);
+    }
+
+    measurement m;
+
+    [[maybe_unused]] auto n = read(fd[0], &m, sizeof(m));
+    wait(nullptr);
+
+    close(fd[0]);
+    close(fd[1]);
+
+    return m;
+}
+
+void report(const char* name, const measurement& m)
+{
+    std::cout << name << ": index " << m.index_ms << " ms (" << m.index_bytes / 1024 / 1024 << " MiB), access "
+              << m.access_ms << " ms, " << m.nodes << " nodes materialised, peak RSS " << m.peak_rss_kb / 1024 << " MiB"
+              << " [" << m.length << "]\n";
+}
+
+
+
+int main()
+{
+    char path[] = "/tmp/telemetry-XXXXXX";  // created by mkstemp, unique and ours only
+
+    const int fd = ::mkstemp(path);
+
+    if (fd < 0) return 1;
+
+    write_payload(fd, 1'000'000);
+
+    std::cout << "file: " << mapped_file{path}.view().size() / 1024 / 1024 << " MiB\n";
+
+    // everything, as it was done so far
+    report("whole tree", measure(path, [](lazy_document::lazy_node root) { return total_length(root.materialize()); }));
+
+    // a few paths only
+    report("three paths", measure(path, [](lazy_document::lazy_node root)
+    {
+        std::size_t r = 0;
+
+        r += root.at(0)->find("tags")->materialize().size();
+        r += root.at(123'456)->find("name")->value().size();
+        r += total_length(root.at(999'999)->find("geo")->materialize());
+
+        return r;
+    }));
+
+    {
+        mapped_file file{path};
+        lazy_document doc;
+
+        doc.build(file.view());
+
+        const auto record = doc.root().at(42);
+
+        std::cout << "record 42:";
+        for (auto it = std::next(record->begin()); it != record->end(); ++it) std::cout << ' ' << it->value();
+        std::cout << '\n';
+
+        const json_node_type& tags = record->find("tags")->materialize();
+
+        std::cout << "tags:";
+        std::for_each(std::next(tags.cbegin()), tags.cend(), [](const auto& x) { std::cout << ' ' << x.value(); });
+        std::cout << " (" << doc.materialised() << " nodes materialised)\n";
+    }
+
+    for (std::string_view text : {R"({"a":[1,2})", R"([1,2]])", R"({"a":"b)", R"(["a""b"])", R"(["a"x])", R"("a"1)", R"({"a":"b"c})", R"([1"a"])", R"({"a":["b", 1 ]})"})
+    {
+        lazy_document doc;
+
+        std::cout << text << " -> " << (doc.build(text) ? "indexed" : "rejected") << '\n';
+    }
+
+    std::remove(path);
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O3 -mavx2 -mpclmul -Wall -pedantic -pthread main.cpp && ./a.out
+file: 102 MiB
+whole tree: index 272.933 ms (274 MiB), access 2193.49 ms, 18000001 nodes materialised, peak RSS 1759 MiB [67777781]
+three paths: index 269.007 ms (274 MiB), access 61.1301 ms, 9 nodes materialised, peak RSS 378 MiB [35]
+record 42: id 42 name user42 active true tags [ geo {
+tags: a bb ccc (4 nodes materialised)
+{"a":[1,2} -> rejected
+[1,2]] -> rejected
+{"a":"b -> rejected
+["a""b"] -> rejected
+["a"x] -> rejected
+"a"1 -> rejected
+{"a":"b"c} -> rejected
+[1"a"] -> rejected
+{"a":["b", 1 ]} -> indexed
+*/
@@ -0,0 +1,478 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout
+
+#include <algorithm>  // push_heap, pop_heap, find_if, lower_bound
+#include <array>  // array
+#include <atomic>  // atomic
+#include <cassert>  // assert
+#include <chrono>  // steady_clock
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t, uint64_t
+#include <limits>  // numeric_limits
+#include <map>  // map
+#include <memory>  // shared_ptr, unique_ptr
+#include <mutex>  // mutex, lock_guard
+#include <new>  // bad_alloc
+#include <optional>  // optional
+#include <thread>  // thread
+#include <tuple>  // tuple
+#include <utility>  // pair, forward
+#include <vector>  // vector
+
+#include <Eigen/Dense>
+
+
+
+// Prepares a free object for its next user: by default a new value is assigned.
+template<class T>
+struct reuse
+{
+    template<class... As>
+    void operator() (T& t, As&&... args) const { t = T(std::forward<As>(args)...); }
+};
+
+// Keeps the storage, as the size class guarantees the same dimensions.
+template<class S, int R, int C, int O, int MR, int MC>
+struct reuse<Eigen::Matrix<S, R, C, O, MR, MC>>
+{
+    void operator() (Eigen::Matrix<S, R, C, O, MR, MC>& m, Eigen::Index rows, Eigen::Index cols) const { m.resize(rows, cols); }
+};
+
+
+enum class pool_error { none, exhausted, no_memory };
+
+
+
+// ------------------------------------
+
+
+// Size classes of at most max objects each. A class keeps its objects in
+// a fixed array: entries below born are allocated, the ones above are
+// unborn. Free entries form a Treiber stack of indices, the head is tagged
+// with a counter bumped on every change, so that a stale head (ABA) fails
+// the exchange.
+template<class T, std::size_t max>
+class size_class
+{
+    static_assert(max < std::numeric_limits<std::uint32_t>::max(), "indices are 32 bits wide");
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "tagged head must be lock-free");
+
+    static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+    static constexpr std::uint64_t pack(std::uint32_t index, std::uint32_t tag) { return (std::uint64_t{tag} << 32) | index; }
+    static constexpr std::uint32_t index_of(std::uint64_t h) { return static_cast<std::uint32_t>(h); }
+    static constexpr std::uint32_t tag_of(std::uint64_t h) { return static_cast<std::uint32_t>(h >> 32); }
+
+    struct entry
+    {
+        T* object = nullptr;  // written before the entry is first pushed
+        std::atomic<std::uint32_t> next{none};
+    };
+
+ public:
+
+    ~size_class()
+    {
+        assert(free_count() == born.load());  // no handle outlives the pool
+
+        for (auto& e : entries) delete e.object;
+    }
+
+    // Pops a free entry, or takes an unborn one; none if all are occupied.
+    std::uint32_t pop()
+    {
+        std::uint64_t h = head.load(std::memory_order_acquire);
+
+        while (index_of(h) != none)
+        {
+            const std::uint32_t next = entries[index_of(h)].next.load(std::memory_order_relaxed);
+
+            if (head.compare_exchange_weak(h, pack(next, tag_of(h) + 1), std::memory_order_acquire, std::memory_order_acquire)) return index_of(h);
+        }
+
+        for (std::uint32_t b = born.load(std::memory_order_relaxed); b < max; )
+        {
+            if (born.compare_exchange_weak(b, b + 1, std::memory_order_relaxed)) return b;
+        }
+
+        return none;
+    }
+
+    void push(std::uint32_t i)
+    {
+        std::uint64_t h = head.load(std::memory_order_relaxed);
+
+        do
+        {
+            entries[i].next.store(index_of(h), std::memory_order_relaxed);
+        }
+        while ( ! head.compare_exchange_weak(h, pack(i, tag_of(h) + 1), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    T*& object(std::uint32_t i) { return entries[i].object; }
+
+    static constexpr bool exhausted(std::uint32_t i) { return i == none; }
+
+ private:
+    std::size_t free_count() const
+    {
+        std::size_t n = 0;
+
+        for (std::uint32_t i = index_of(head.load()); i != none; i = entries[i].next.load()) ++n;
+
+        return n;
+    }
+
+    alignas(64) std::atomic<std::uint64_t> head{pack(none, 0)};
+    alignas(64) std::atomic<std::uint32_t> born{0};
+    std::array<entry, max> entries;
+};
+
+
+// Lookups go through an immutable sorted snapshot of the classes: a reader
+// does a single acquire load and a binary search, no lock is taken unless a
+// new class is added. Replaced snapshots are kept until the pool goes, as
+// there is no way to tell when the last reader left them; classes are few
+// and added once, so that is bounded.
+template<class T, std::size_t max, class K = std::tuple<std::size_t, std::size_t>>
+class lock_free_pool
+{
+    using klass = size_class<T, max>;
+    using snapshot = std::vector<std::pair<K, klass*>>;
+
+    static constexpr auto by_key = [](const std::pair<K, klass*>& e, const K& k) { return e.first < k; };
+
+ public:
+
+    using key_type = K;
+
+    // Puts the object back into its size class; O(1), the entry index is known.
+    class deleter
+    {
+     public:
+        deleter() = default;
+        deleter(klass* c, std::uint32_t i) : home{c}, index{i} {}
+
+        void operator() (T* p) const
+        {
+            assert(home->object(index) == p);
+
+            home->push(index);
+        }
+
+     private:
+        klass* home = nullptr;
+        std::uint32_t index = 0;
+    };
+
+    using handle = std::unique_ptr<T, deleter>;
+
+    lock_free_pool() : current{snapshots.emplace_back(std::make_unique<snapshot>()).get()} {}
+
+    lock_free_pool(const lock_free_pool&) = delete;
+    lock_free_pool& operator= (const lock_free_pool&) = delete;
+
+    template<class... As>
+    std::pair<pool_error, std::optional<handle>> construct(const K& k, As&&... args)
+    {
+        klass& c = find_or_add(k);
+
+        const std::uint32_t i = c.pop();
+
+        if (klass::exhausted(i)) return {pool_error::exhausted, std::nullopt};
+
+        T*& p = c.object(i);
+
+        try
+        {
+            if (p == nullptr) p = new T(std::forward<As>(args)...);  // unborn, or allocation failed before
+            else reuse<T>{}(*p, std::forward<As>(args)...);
+        }
+        catch (const std::bad_alloc&)
+        {
+            c.push(i);
+            return {pool_error::no_memory, std::nullopt};
+        }
+        catch (...)
+        {
+            c.push(i);
+            throw;
+        }
+
+        return {pool_error::none, handle{p, deleter{&c, i}}};
+    }
+
+ private:
+    static klass* find(const snapshot& s, const K& k)
+    {
+        const auto it = std::lower_bound(s.begin(), s.end(), k, by_key);
+
+        return ((it != s.end()) && (it->first == k)) ? it->second : nullptr;
+    }
+
+    klass& find_or_add(const K& k)
+    {
+        if (klass* c = find(*current.load(std::memory_order_acquire), k)) return *c;
+
+        std::lock_guard<std::mutex> lock{m};
+
+        const snapshot& last = *current.load(std::memory_order_relaxed);
+
+        if (klass* c = find(last, k)) return *c;  // added in the meantime
+
+        klass* c = classes.emplace_back(std::make_unique<klass>()).get();
+
+        auto next = std::make_unique<snapshot>(last);
+        next->insert(std::lower_bound(next->begin(), next->end(), k, by_key), {k, c});
+
+        current.store(snapshots.emplace_back(std::move(next)).get(), std::memory_order_release);
+
+        return *c;
+    }
+
+    std::mutex m;  // serialises writers only
+    std::vector<std::unique_ptr<klass>> classes;
+    std::vector<std::unique_ptr<snapshot>> snapshots;
+    std::atomic<const snapshot*> current;
+};
+
+
+
+// ---
+
+
+// Mutex-guarded variant from coliru/2d6a8f04c1e9b753.cpp, condensed.
+template<class T>
+using slot = std::pair<T*, std::size_t>;
+
+struct by_preference
+{
+    template<class T>
+    bool operator() (const slot<T>& a, const slot<T>& b) const { return rank(a) < rank(b); }
+
+    template<class T>
+    static int rank(const slot<T>& s) { return (s.first == nullptr) ? ((s.second == 0) ? 2 : 0) : ((s.second == 0) ? 3 : 1); }
+};
+
+template<class T, std::size_t max, class K = std::tuple<std::size_t, std::size_t>>
+class locked_pool
+{
+    using bucket = std::pair<std::mutex, std::array<slot<T>, max>>;
+
+    static void sift_up(std::array<slot<T>, max>& slots, std::size_t i)
+    {
+        for (std::size_t parent = (i - 1) / 2; (i > 0) && by_preference{}(slots[parent], slots[i]); i = parent, parent = (i - 1) / 2)
+        {
+            std::swap(slots[parent], slots[i]);
+        }
+    }
+
+    static std::shared_ptr<bucket> make_bucket()
+    {
+        return std::shared_ptr<bucket>(new bucket{}, [](bucket* b) { for (auto& s : b->second) delete s.first; delete b; });
+    }
+
+ public:
+
+    class deleter
+    {
+     public:
+        deleter() = default;
+        explicit deleter(std::shared_ptr<bucket> b) : home{std::move(b)} {}
+
+        void operator() (T* p) const
+        {
+            std::lock_guard<std::mutex> lock{home->first};
+
+            auto& slots = home->second;
+            const auto it = std::find_if(slots.begin(), slots.end(), [p](const slot<T>& s) { return s.first == p; });
+
+            it->second = 0;
+            sift_up(slots, static_cast<std::size_t>(it - slots.begin()));
+        }
+
+     private:
+        std::shared_ptr<bucket> home;
+    };
+
+    using handle = std::unique_ptr<T, deleter>;
+
+    template<class... As>
+    std::pair<pool_error, std::optional<handle>> construct(const K& k, As&&... args)
+    {
+        std::shared_ptr<bucket> b = find_or_add(k);
+
+        std::lock_guard<std::mutex> lock{b->first};
+
+        auto& slots = b->second;
+
+        std::pop_heap(slots.begin(), slots.end(), by_preference{});
+
+        slot<T>& s = slots.back();
+
+        if (s.second != 0) { std::push_heap(slots.begin(), slots.end(), by_preference{}); return {pool_error::exhausted, std::nullopt}; }
+
+        if (s.first == nullptr) s.first = new T(std::forward<As>(args)...);
+        else reuse<T>{}(*s.first, std::forward<As>(args)...);
+
+        s.second = 1;
+
+        T* p = s.first;
+
+        std::push_heap(slots.begin(), slots.end(), by_preference{});
+
+        return {pool_error::none, handle{p, deleter{b}}};
+    }
+
+ private:
+    std::shared_ptr<bucket> find_or_add(const K& k)
+    {
+        std::lock_guard<std::mutex> lock{m};
+
+        auto it = buckets.find(k);
+
+        if (it == buckets.end()) it = buckets.emplace(k, make_bucket()).first;
+
+        return it->second;
+    }
+
+    std::mutex m;
+    std::map<K, std::shared_ptr<bucket>> buckets;
+};
+
+
+
+// ---
+
+
+// Every thread marks the matrices it holds with its own number and checks
+// the mark is still there before giving them back: an object handed out
+// twice would be overwritten by the other thread.
+template<class Pool>
+bool exclusive(std::size_t threads, std::size_t rounds)
+{
+    Pool pool;
+    std::atomic<bool> ok{true};
+    std::vector<std::thread> workers;
+
+    for (std::size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&pool, &ok, t, rounds]
+        {
+            for (std::size_t i = 0; i < rounds; ++i)
+            {
+                const int n = 3 + static_cast<int>(i % 2);  // two classes
+
+                auto a = pool.construct({n, n}, n, n);
+                auto b = pool.construct({n, n}, n, n);
+
+                if ( ! a.second || ! b.second) { ok = false; return; }
+
+                (*a.second)->setConstant(static_cast<double>(t));
+                (*b.second)->setConstant(static_cast<double>(t));
+
+                std::this_thread::yield();
+
+                if (((*a.second)->maxCoeff() != t) || ((*b.second)->minCoeff() != t)) ok = false;
+            }
+        });
+    }
+
+    for (auto& w : workers) w.join();
+
+    return ok;
+}
+
+template<class F>
+double ms(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    f();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Same-sized matrices acquired and returned in a tight loop by every thread.
+template<class Acquire>
+double hammer(std::size_t threads, std::size_t rounds, Acquire acquire)
+{
+    return ms([&]
+    {
+        std::vector<std::thread> workers;
+        std::vector<double> sinks(threads);
+
+        for (std::size_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&acquire, &sink = sinks[t], rounds]
+            {
+                for (std::size_t i = 0; i < rounds; ++i)
+                {
+                    auto m = acquire();
+
+                    m->setConstant(static_cast<double>(i));
+                    sink += (*m)(0, 0);
+                }
+            });
+        }
+
+        for (auto& w : workers) w.join();
+    });
+}
+
+
+
+int main()
+{
+    constexpr std::size_t threads = 4;
+    constexpr std::size_t max = 64;
+
+    std::cout << "lock-free exclusive: " << std::boolalpha << exclusive<lock_free_pool<Eigen::MatrixXd, max>>(threads, 100'000) << '\n';
+    std::cout << "locked exclusive:    " << exclusive<locked_pool<Eigen::MatrixXd, max>>(threads, 100'000) << '\n';
+
+    {
+        lock_free_pool<Eigen::MatrixXd, 2> pool;
+
+        auto a = pool.construct({3, 3}, 3, 3);
+        auto b = pool.construct({3, 3}, 3, 3);
+        auto c = pool.construct({3, 3}, 3, 3);
+
+        const Eigen::MatrixXd* first = a.second->get();
+
+        a.second.reset();
+
+        auto d = pool.construct({3, 3}, 3, 3);
+
+        std::cout << "exhausted: " << (c.first == pool_error::exhausted) << ", reused: " << (d.second->get() == first) << '\n';
+    }
+
+    constexpr std::size_t rounds = 2'000'000;
+
+    const double plain = hammer(threads, rounds, [] { return std::make_unique<Eigen::MatrixXd>(4, 4); });
+
+    locked_pool<Eigen::MatrixXd, max> locked;
+    const double with_lock = hammer(threads, rounds, [&locked] { return std::move(*locked.construct({4, 4}, 4, 4).second); });
+
+    lock_free_pool<Eigen::MatrixXd, max> lock_free;
+    const double without_lock = hammer(threads, rounds, [&lock_free] { return std::move(*lock_free.construct({4, 4}, 4, 4).second); });
+
+    std::cout << threads << " threads x " << rounds << " rounds, 4x4, " << std::thread::hardware_concurrency() << " cores\n";
+    std::cout << "new/delete:  " << plain << " ms\n";
+    std::cout << "locked pool: " << with_lock << " ms\n";
+    std::cout << "lock-free:   " << without_lock << " ms\n";
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O2 -Wall -pedantic -pthread -I/usr/include/eigen3 main.cpp && ./a.out
+lock-free exclusive: true
+locked exclusive:    true
+exhausted: true, reused: true
+4 threads x 2000000 rounds, 4x4, 1 cores
+new/delete:  381.082 ms
+locked pool: 1577.68 ms
+lock-free:   382.417 ms
+*/
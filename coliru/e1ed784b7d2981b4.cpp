@@ -0,0 +1,471 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout
+
+#include <algorithm>  // min, sort, lower_bound, adjacent_find
+#include <array>  // array
+#include <cstddef>  // size_t, byte
+#include <cstdint>  // uint32_t, uint64_t
+#include <cstring>  // memcpy
+#include <optional>  // optional
+#include <string>  // string
+#include <string_view>  // string_view
+#include <tuple>  // tuple, tuple_element_t, apply
+#include <type_traits>  // false_type, true_type, is_arithmetic, is_same
+#include <utility>  // index_sequence, pair
+#include <vector>  // vector
+
+
+
+// Compile-time type names and hashes (see template-instance-deconstruction.md).
+
+template<class T>
+struct name_of;
+
+template<> struct name_of<int>         { static constexpr std::string_view value = "Int"; };
+template<> struct name_of<double>      { static constexpr std::string_view value = "Double"; };
+template<> struct name_of<std::string> { static constexpr std::string_view value = "String"; };
+
+template<template<class...> class S>
+struct shape_of;
+
+template<>
+struct shape_of<std::vector>
+{
+    static constexpr std::string_view prefix = "[", separator = "", suffix = "]";
+    static constexpr std::size_t arity = 1;
+};
+
+template<>
+struct shape_of<std::optional>
+{
+    static constexpr std::string_view prefix = "Maybe[", separator = "", suffix = "]";
+    static constexpr std::size_t arity = 1;
+};
+
+
+template<class T, class = void>
+struct has_name : std::false_type {};
+
+template<class T>
+struct has_name<T, std::void_t<decltype(name_of<T>::value)>> : std::true_type {};
+
+template<template<class...> class S, class = void>
+struct has_shape : std::false_type {};
+
+template<template<class...> class S>
+struct has_shape<S, std::void_t<decltype(shape_of<S>::arity)>> : std::true_type {};
+
+
+template<class T>
+struct deconstruct : std::false_type {};
+
+template<template<class...> class S, class... Ts>
+struct deconstruct<S<Ts...>> : std::true_type
+{
+    using shape = shape_of<S>;
+    using type = std::tuple<Ts...>;
+};
+
+template<class T>
+constexpr bool is_shaped = false;
+
+template<template<class...> class S, class... Ts>
+constexpr bool is_shaped<S<Ts...>> = has_shape<S>::value;
+
+
+template<class T, class Out>
+constexpr void render(Out& out);
+
+template<class Ts, class Shape, class Out, std::size_t... Is>
+constexpr void render_each(Out& out, std::index_sequence<Is...>)
+{
+    ((out(Is ? Shape::separator : std::string_view{}), render<std::tuple_element_t<Is, Ts>>(out)), ...);
+}
+
+template<class T, class Out>
+constexpr void render(Out& out)
+{
+    static_assert(has_name<T>::value || is_shaped<T>, "T has no stable name");
+
+    if constexpr (has_name<T>::value)
+    {
+        out(name_of<T>::value);
+    }
+    else
+    {
+        using shape = typename deconstruct<T>::shape;
+        using parameters = typename deconstruct<T>::type;
+
+        constexpr std::size_t n = std::min(shape::arity, std::tuple_size_v<parameters>);
+
+        out(shape::prefix);
+        render_each<parameters, shape>(out, std::make_index_sequence<n>{});
+        out(shape::suffix);
+    }
+}
+
+struct counter
+{
+    constexpr void operator() (std::string_view s) { size += s.size(); }
+
+    std::size_t size = 0;
+};
+
+template<std::size_t N>
+struct writer
+{
+    constexpr void operator() (std::string_view s) { for (char c : s) buffer[size++] = c; }
+
+    std::array<char, N> buffer{};
+    std::size_t size = 0;
+};
+
+template<class T>
+struct type_name
+{
+    static constexpr std::size_t size = [] { counter c; render<T>(c); return c.size; }();
+
+    static constexpr std::array<char, size> buffer = [] { writer<size> w; render<T>(w); return w.buffer; }();
+
+    static constexpr std::string_view value{buffer.data(), size};
+};
+
+constexpr std::uint64_t fnv1a(std::string_view s)
+{
+    std::uint64_t h = 0xcbf29ce484222325;
+
+    for (char c : s) h = (h ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+
+    return h;
+}
+
+template<class T>
+inline constexpr std::string_view type_name_v = type_name<T>::value;
+
+template<class T>
+inline constexpr std::uint64_t type_hash_v = fnv1a(type_name_v<T>);
+
+
+
+// ------------------------------------
+
+
+// A message is a named product of fields, its ID follows from its deconstructed structure.
+template<class Name, class... Fields>
+struct message
+{
+    std::tuple<Fields...> fields;
+};
+
+template<>
+struct shape_of<message>
+{
+    static constexpr std::string_view prefix = "msg(", separator = ", ", suffix = ")";
+    static constexpr std::size_t arity = static_cast<std::size_t>(-1);
+};
+
+
+using bytes = std::vector<std::byte>;
+
+// Cursor over the received bytes, all reads are bounds-checked.
+struct reader
+{
+    // Types whose every object representation is a valid value only (not bool).
+    template<class T>
+    bool raw(T& t)
+    {
+        static_assert(std::is_arithmetic_v<T> && ! std::is_same_v<T, bool>, "not every byte pattern is a T");
+
+        if (sizeof(T) > size) return false;
+
+        std::memcpy(&t, data, sizeof(T));
+        skip(sizeof(T));
+
+        return true;
+    }
+
+    void skip(std::size_t n) { data += n; size -= n; }
+
+    const std::byte* data;
+    std::size_t size;
+};
+
+
+// Wire format: arithmetic types as-is (little endian hosts only),
+// sequences prefixed with 32-bit length, optional with one-byte flag.
+template<class T, class = void>
+struct codec;
+
+template<class T>
+struct codec<T, std::enable_if_t<std::is_arithmetic_v<T> && ! std::is_same_v<T, bool>>>
+{
+    static void encode(const T& t, bytes& out)
+    {
+        const auto* p = reinterpret_cast<const std::byte*>(&t);
+
+        out.insert(out.end(), p, p + sizeof(T));
+    }
+
+    static bool decode(reader& in, T& t) { return in.raw(t); }
+};
+
+// One byte, 0 or 1: any other value is malformed rather than copied into a bool.
+template<>
+struct codec<bool>
+{
+    static void encode(bool b, bytes& out) { out.push_back(std::byte{b}); }
+
+    static bool decode(reader& in, bool& b)
+    {
+        std::uint8_t x = 0;
+
+        if ( ! in.raw(x) || (x > 1)) return false;
+
+        b = (x == 1);
+
+        return true;
+    }
+};
+
+template<>
+struct codec<std::string>
+{
+    static void encode(const std::string& s, bytes& out)
+    {
+        codec<std::uint32_t>::encode(static_cast<std::uint32_t>(s.size()), out);
+
+        const auto* p = reinterpret_cast<const std::byte*>(s.data());
+
+        out.insert(out.end(), p, p + s.size());
+    }
+
+    static bool decode(reader& in, std::string& s)
+    {
+        std::uint32_t n = 0;
+
+        if ( ! in.raw(n) || (n > in.size)) return false;
+
+        s.assign(reinterpret_cast<const char*>(in.data), n);
+        in.skip(n);
+
+        return true;
+    }
+};
+
+template<class T>
+struct codec<std::vector<T>>
+{
+    static void encode(const std::vector<T>& v, bytes& out)
+    {
+        codec<std::uint32_t>::encode(static_cast<std::uint32_t>(v.size()), out);
+
+        for (const auto& x : v) codec<T>::encode(x, out);
+    }
+
+    static bool decode(reader& in, std::vector<T>& v)
+    {
+        std::uint32_t n = 0;
+
+        if ( ! in.raw(n) || (n > in.size)) return false;  // no element is encoded in 0 bytes
+
+        v.resize(n);
+
+        return std::all_of(v.begin(), v.end(), [&in](T& x) { return codec<T>::decode(in, x); });
+    }
+};
+
+template<class T>
+struct codec<std::optional<T>>
+{
+    static void encode(const std::optional<T>& o, bytes& out)
+    {
+        codec<bool>::encode(o.has_value(), out);
+
+        if (o) codec<T>::encode(*o, out);
+    }
+
+    static bool decode(reader& in, std::optional<T>& o)
+    {
+        bool present = false;
+
+        if ( ! codec<bool>::decode(in, present)) return false;
+
+        if ( ! present) { o.reset(); return true; }
+
+        return codec<T>::decode(in, o.emplace());
+    }
+};
+
+template<class Name, class... Fields>
+struct codec<message<Name, Fields...>>
+{
+    static void encode(const message<Name, Fields...>& m, bytes& out)
+    {
+        std::apply([&out](const Fields&... fs) { (codec<Fields>::encode(fs, out), ...); }, m.fields);
+    }
+
+    static bool decode(reader& in, message<Name, Fields...>& m)
+    {
+        return std::apply([&in](Fields&... fs) { return (codec<Fields>::decode(in, fs) && ...); }, m.fields);
+    }
+};
+
+
+
+// ---
+
+
+// Dispatch table over Ms... sorted by ID at compile time: decoding is
+// a binary search over integers followed by an indirect call.
+template<class... Ms>
+class message_registry
+{
+    static constexpr std::size_t N = sizeof...(Ms);
+
+    using entry = std::pair<std::uint64_t, std::size_t>;  // ID, index in Ms
+
+    static constexpr std::array<entry, N> ids = []
+    {
+        std::size_t i = 0;
+        std::array<entry, N> r{entry{type_hash_v<Ms>, i++}...};
+
+        std::sort(r.begin(), r.end());
+
+        return r;
+    }();
+
+    static_assert(std::adjacent_find(ids.begin(), ids.end()
+                                   , [](const entry& a, const entry& b) { return a.first == b.first; })
+                  == ids.end(), "ID collision, rename one of the messages");
+
+    template<class V>
+    using decoder = bool (*)(reader&, V&);
+
+    template<class M, class V>
+    static bool decode_as(reader& in, V& visitor)
+    {
+        M m{};
+
+        if ( ! codec<M>::decode(in, m)) return false;
+
+        visitor(std::move(m));
+
+        return true;
+    }
+
+    template<class V>
+    static constexpr std::array<decoder<V>, N> decoders = []
+    {
+        constexpr std::array<decoder<V>, N> by_index{&decode_as<Ms, V>...};
+
+        std::array<decoder<V>, N> r{};
+
+        for (std::size_t k = 0; k < N; ++k) r[k] = by_index[ids[k].second];  // follow the ID order
+
+        return r;
+    }();
+
+ public:
+
+    template<class M>
+    static constexpr std::uint64_t id = type_hash_v<M>;
+
+    template<class M>
+    static void encode(const M& m, bytes& out)
+    {
+        static_assert((std::is_same_v<M, Ms> || ...), "M not registered");
+
+        codec<std::uint64_t>::encode(id<M>, out);
+        codec<M>::encode(m, out);
+    }
+
+    // Calls visitor with the decoded message, false on unknown ID or malformed payload.
+    template<class V>
+    static bool decode(reader& in, V&& visitor)
+    {
+        std::uint64_t tag = 0;
+
+        if ( ! in.raw(tag)) return false;
+
+        const auto it = std::lower_bound(ids.begin(), ids.end(), entry{tag, 0});
+
+        if ((it == ids.end()) || (it->first != tag)) return false;
+
+        return decoders<V>[it - ids.begin()](in, visitor);
+    }
+};
+
+
+
+// ---
+
+
+struct Login;
+struct Quote;
+struct Logout;
+
+template<> struct name_of<Login>  { static constexpr std::string_view value = "Login"; };
+template<> struct name_of<Quote>  { static constexpr std::string_view value = "Quote"; };
+template<> struct name_of<Logout> { static constexpr std::string_view value = "Logout"; };
+
+using login  = message<Login, std::string, std::optional<int>>;
+using quote  = message<Quote, std::string, std::vector<double>>;
+using logout = message<Logout, int>;
+
+using protocol = message_registry<login, quote, logout>;
+
+
+template<class... Fs>
+struct overloaded : Fs... { using Fs::operator()...; };
+
+template<class... Fs>
+overloaded(Fs...) -> overloaded<Fs...>;
+
+
+
+int main()
+{
+    bytes wire;
+
+    protocol::encode(quote{{"EURUSD", {1.0841, 1.0843}}}, wire);
+    protocol::encode(login{{"alice", 42}}, wire);
+    protocol::encode(logout{{7}}, wire);
+
+    std::cout << type_name_v<quote> << " -> " << std::hex << protocol::id<quote> << std::dec << '\n';
+
+    reader in{wire.data(), wire.size()};
+
+    const auto print = overloaded
+    {
+        [](login&& m) { std::cout << "login " << std::get<0>(m.fields) << ' ' << std::get<1>(m.fields).value_or(-1) << '\n'; }
+      , [](quote&& m) { std::cout << "quote " << std::get<0>(m.fields) << ' ' << std::get<1>(m.fields).size() << '\n'; }
+      , [](logout&& m) { std::cout << "logout " << std::get<0>(m.fields) << '\n'; }
+    };
+
+    while ((in.size > 0) && protocol::decode(in, print)) {}
+
+    std::cout << "left: " << in.size << '\n';
+
+    bytes bad;
+
+    protocol::encode(login{{"bob", 1}}, bad);
+    bad[8 + 4 + 3] = std::byte{2};  // ID, length, "bob", then the flag of the optional
+
+    reader malformed{bad.data(), bad.size()};
+
+    std::cout << "flag 2 accepted: " << std::boolalpha << protocol::decode(malformed, print) << '\n';
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++20 -O2 -Wall -pedantic -pthread main.cpp && ./a.out
+msg(Quote, String, [Double]) -> 78ede8cc1776477b
+quote EURUSD 2
+login alice 42
+logout 7
+left: 0
+flag 2 accepted: false
+*/
@@ -0,0 +1,750 @@
+// see LICENSE on insooth.github.io
+
+#include <iostream>  // cout
+
+#include <algorithm>  // for_each
+#include <cassert>  // assert
+#include <chrono>  // steady_clock
+#include <cstddef>  // size_t
+#include <cstdint>  // uint32_t, uint64_t
+#include <cstring>  // memcpy, memset
+#include <limits>  // numeric_limits
+#include <memory>  // unique_ptr
+#include <memory_resource>  // monotonic_buffer_resource, memory_resource
+#include <string>  // string, to_string
+#include <string_view>  // string_view
+#include <utility>  // pair
+#include <vector>  // vector
+
+#if defined(__AVX2__) && defined(__PCLMUL__)
+#include <immintrin.h>  // _mm256_*, _mm_clmulepi64_si128
+#endif
+
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/iterator/iterator_categories.hpp>
+
+
+
+// Flat layout: all the nodes of a document live in one contiguous array in
+// the order they appear in the text (root first), every node knows where its
+// subtree ends, which is where its next sibling starts. Nodes are written
+// once, in place, as they are found. Strings point into the source buffer
+// (which must outlive the document). Objects store their members as key,
+// value pairs of children; containers carry "{" or "[".
+class json_document
+{
+    struct node
+    {
+        std::string_view data;
+        std::uint32_t next = 0;  // index past the subtree: the next sibling
+        std::uint32_t count = 0;  // number of children
+    };
+
+ public:
+
+    // Lightweight handle with the forward traversal interface of json_node_type:
+    // element 0 is the node itself, elements 1..n are its children.
+    class node_ref
+    {
+        template<class T>
+        class iter
+          : public boost::iterator_facade<iter<T>, T, boost::forward_traversal_tag, T>
+        {
+         public:
+            iter(T _n, std::uint32_t _at) : n{_n}, at{_at} {}
+
+         private:
+            friend class boost::iterator_core_access;
+
+            bool equal(const iter& other) const
+            {
+                return (at == other.at) && (n.index == other.n.index) && (n.doc == other.n.doc);
+            }
+
+            // the node itself, then its first child right after it, then the siblings
+            void increment()
+            {
+                assert(at != n.doc->nodes[n.index].next);
+
+                at = (at == n.index) ? at + 1 : n.doc->nodes[at].next;
+            }
+
+            T dereference() const { return (at == n.index) ? n : T{n.doc, at}; }
+
+            T n;
+            std::uint32_t at;  // index of the current node
+        };
+
+     public:
+
+        using size_type = std::uint32_t;
+        using iterator = iter<node_ref>;
+        using const_iterator = iter<node_ref>;
+
+        node_ref(const json_document* d, std::uint32_t i) : doc{d}, index{i} {}
+
+        size_type size() const noexcept { return 1 + doc->nodes[index].count; }
+
+        iterator begin() const noexcept { return iterator{*this, index}; }
+        iterator end() const noexcept { return iterator{*this, doc->nodes[index].next}; }
+
+        const_iterator cbegin() const noexcept { return begin(); }
+        const_iterator cend() const noexcept { return end(); }
+
+        std::string_view value() const noexcept { return doc->nodes[index].data; }
+
+     private:
+        const json_document* doc;
+        std::uint32_t index;
+    };
+
+    explicit json_document(std::pmr::memory_resource* r = std::pmr::get_default_resource())
+      : nodes{r}, frames{r}
+    {}
+
+    // Keeps the memory for the next document.
+    void clear() { nodes.clear(); frames.clear(); }
+
+    // There are never more nodes than structural positions.
+    void reserve(std::size_t n) { nodes.reserve(n); }
+
+    node_ref root() const { assert( ! nodes.empty()); return node_ref{this, 0}; }
+
+    std::size_t node_count() const noexcept { return nodes.size(); }
+
+    // builder interface, see parse()
+
+    void on_open(std::string_view s)
+    {
+        on_scalar(s);
+        frames.push_back(static_cast<std::uint32_t>(nodes.size() - 1));
+    }
+
+    void on_scalar(std::string_view s)
+    {
+        const auto i = static_cast<std::uint32_t>(nodes.size());
+
+        if ( ! frames.empty()) ++nodes[frames.back()].count;
+
+        nodes.push_back(node{s, i + 1});
+    }
+
+    // The subtree of the closed container ends here.
+    void on_close()
+    {
+        nodes[frames.back()].next = static_cast<std::uint32_t>(nodes.size());
+        frames.pop_back();
+    }
+
+    void on_end() { assert(frames.empty()); }
+
+ private:
+    std::pmr::vector<node> nodes;
+    std::pmr::vector<std::uint32_t> frames;  // indices of the open containers
+};
+
+
+// Minimal recursive-descent JSON reader that emits events into a Builder.
+// Strings are reported without quotes and with escapes left as they are.
+template<class Builder>
+class json_reader
+{
+ public:
+    json_reader(std::string_view s, Builder& b) : src{s}, builder{b} {}
+
+    bool parse()
+    {
+        if ( ! value()) return false;
+
+        builder.on_end();
+        skip_ws();
+
+        return pos == src.size();
+    }
+
+ private:
+    void skip_ws()
+    {
+        while ((pos < src.size()) && ((src[pos] == ' ') || (src[pos] == '\n') || (src[pos] == '\t') || (src[pos] == '\r'))) ++pos;
+    }
+
+    bool string(std::string_view& out)
+    {
+        const std::size_t begin = ++pos;  // skip opening quote
+
+        while ((pos < src.size()) && (src[pos] != '"')) pos += (src[pos] == '\\') ? 2 : 1;
+
+        if (pos >= src.size()) return false;
+
+        out = src.substr(begin, pos++ - begin);
+
+        return true;
+    }
+
+    bool container(char close)
+    {
+        builder.on_open(src.substr(pos++, 1));
+        skip_ws();
+
+        if ((pos < src.size()) && (src[pos] == close)) { ++pos; builder.on_close(); return true; }
+
+        for (;;)
+        {
+            if (close == '}')
+            {
+                std::string_view key;
+
+                if ((pos >= src.size()) || (src[pos] != '"') || ! string(key)) return false;
+
+                builder.on_scalar(key);
+                skip_ws();
+
+                if ((pos >= src.size()) || (src[pos++] != ':')) return false;
+            }
+
+            if ( ! value()) return false;
+
+            skip_ws();
+
+            if (pos >= src.size()) return false;
+
+            if (src[pos] == ',') { ++pos; continue; }
+            if (src[pos] == close) { ++pos; builder.on_close(); return true; }
+
+            return false;
+        }
+    }
+
+    bool value()
+    {
+        skip_ws();
+
+        if (pos >= src.size()) return false;
+
+        switch (src[pos])
+        {
+            case '{': return container('}');
+            case '[': return container(']');
+            case '"':
+            {
+                std::string_view s;
+
+                if ( ! string(s)) return false;
+
+                builder.on_scalar(s);
+
+                return true;
+            }
+            default:  // number, true, false, null
+            {
+                const std::size_t begin = pos;
+
+                while ((pos < src.size()) && (std::string_view{",]} \n\t\r"}.find(src[pos]) == std::string_view::npos)) ++pos;
+
+                if (pos == begin) return false;
+
+                builder.on_scalar(src.substr(begin, pos - begin));
+
+                return true;
+            }
+        }
+    }
+
+    std::string_view src;
+    std::size_t pos = 0;
+    Builder& builder;
+};
+
+template<class Builder>
+bool parse(std::string_view s, Builder& b)
+{
+    return json_reader<Builder>{s, b}.parse();
+}
+
+
+
+// ------------------------------------
+
+
+// Stage 1: find positions of all the structural characters ({}[]:,), of the
+// quotes and of the first characters of the other scalars, 64 bytes at once.
+// Based on the simdjson approach (Langdale, Lemire: "Parsing Gigabytes of JSON per Second").
+class structural_index
+{
+    struct block
+    {
+        std::uint64_t quote;
+        std::uint64_t backslash;
+        std::uint64_t op;  // { } [ ] : ,
+        std::uint64_t whitespace;
+    };
+
+#if defined(__AVX2__) && defined(__PCLMUL__)
+    static std::uint64_t mask(__m256i lo, __m256i hi)
+    {
+        const auto l = static_cast<std::uint32_t>(_mm256_movemask_epi8(lo));
+        const auto h = static_cast<std::uint32_t>(_mm256_movemask_epi8(hi));
+
+        return (std::uint64_t{h} << 32) | l;
+    }
+
+    // Table lookup by the low nibble: a character is a whitespace (or an operator)
+    // if it equals the table entry selected by its own low nibble.
+    static block classify(const char* p)
+    {
+        const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+
+        const __m256i ws = _mm256_setr_epi8(' ', 100, 100, 100, 17, 100, 113, 2, 100, '\t', '\n', 112, 100, '\r', 100, 100
+                                          , ' ', 100, 100, 100, 17, 100, 113, 2, 100, '\t', '\n', 112, 100, '\r', 100, 100);
+        const __m256i op = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', '{', ',', '}', 0, 0
+                                          , 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', '{', ',', '}', 0, 0);
+        const __m256i lower = _mm256_set1_epi8(0x20);  // maps [ ] into { }
+        const __m256i quote = _mm256_set1_epi8('"');
+        const __m256i backslash = _mm256_set1_epi8('\\');
+
+        return block
+        {
+            mask(_mm256_cmpeq_epi8(lo, quote), _mm256_cmpeq_epi8(hi, quote))
+          , mask(_mm256_cmpeq_epi8(lo, backslash), _mm256_cmpeq_epi8(hi, backslash))
+          , mask(_mm256_cmpeq_epi8(_mm256_shuffle_epi8(op, lo), _mm256_or_si256(lo, lower))
+               , _mm256_cmpeq_epi8(_mm256_shuffle_epi8(op, hi), _mm256_or_si256(hi, lower)))
+          , mask(_mm256_cmpeq_epi8(_mm256_shuffle_epi8(ws, lo), lo)
+               , _mm256_cmpeq_epi8(_mm256_shuffle_epi8(ws, hi), hi))
+        };
+    }
+
+    // Bit i of the result is the XOR of bits 0..i of x: "inside of a quoted string".
+    static std::uint64_t prefix_xor(std::uint64_t x)
+    {
+        const __m128i r = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<long long>(x)), _mm_set1_epi8(-1), 0);
+
+        return static_cast<std::uint64_t>(_mm_cvtsi128_si64(r));
+    }
+#else
+    static block classify(const char* p)
+    {
+        block b{};
+
+        for (std::uint64_t i = 0; i < 64; ++i)
+        {
+            const char c = p[i];
+
+            b.quote |= std::uint64_t{c == '"'} << i;
+            b.backslash |= std::uint64_t{c == '\\'} << i;
+            b.op |= std::uint64_t{(c == '{') || (c == '}') || (c == '[') || (c == ']') || (c == ':') || (c == ',')} << i;
+            b.whitespace |= std::uint64_t{(c == ' ') || (c == '\n') || (c == '\t') || (c == '\r')} << i;
+        }
+
+        return b;
+    }
+
+    static std::uint64_t prefix_xor(std::uint64_t x)
+    {
+        for (unsigned shift = 1; shift < 64; shift *= 2) x ^= x << shift;
+
+        return x;
+    }
+#endif
+
+    // Characters preceded by an odd number of backslashes.
+    std::uint64_t escaped(std::uint64_t backslash)
+    {
+        constexpr std::uint64_t even_bits = 0x5555555555555555;
+
+        backslash &= ~prev_escaped;
+
+        const std::uint64_t follows_escape = (backslash << 1) | prev_escaped;
+        const std::uint64_t odd_starts = backslash & ~even_bits & ~follows_escape;
+
+        std::uint64_t even_starts = 0;
+        prev_escaped = __builtin_add_overflow(odd_starts, backslash, &even_starts);
+
+        return (even_bits ^ (even_starts << 1)) & follows_escape;
+    }
+
+    void step(const char* p, std::uint32_t offset)
+    {
+        const block b = classify(p);
+
+        const std::uint64_t quote = b.quote & ~escaped(b.backslash);
+        const std::uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+
+        prev_in_string = static_cast<std::uint64_t>(static_cast<std::int64_t>(in_string) >> 63);
+
+        // quotes end a scalar, so that a token right after a closing quote gets its own position
+        const std::uint64_t scalar = ~(b.op | b.whitespace | quote);
+        const std::uint64_t follows_scalar = (scalar << 1) | prev_scalar;
+
+        prev_scalar = scalar >> 63;
+
+        // both quotes: stage 2 finds the end of a string without looking at its bytes
+        const std::uint64_t inside = in_string & ~quote;
+        std::uint64_t structurals = (b.op | quote | (scalar & ~follows_scalar)) & ~inside;
+
+        // Branch-light flattening: 8 positions are written at once, even if fewer
+        // bits are set; the buffer has room for that, and count tells what is valid.
+        const auto n = static_cast<std::size_t>(__builtin_popcountll(structurals));
+        std::uint32_t* out = positions.get() + count;
+
+        while (structurals)
+        {
+            for (int k = 0; k < 8; ++k)
+            {
+                out[k] = offset + static_cast<std::uint32_t>(__builtin_ctzll(structurals | (std::uint64_t{1} << 63)));
+                structurals &= structurals - 1;
+            }
+
+            out += 8;
+        }
+
+        count += n;
+    }
+
+ public:
+    // false on unterminated string, or a source that 32-bit positions cannot address
+    bool build(std::string_view s)
+    {
+        if (s.size() > std::numeric_limits<std::uint32_t>::max() - 64) return false;
+
+        if (capacity < s.size() + 64)  // at most one position per byte, plus the overrun
+        {
+            capacity = s.size() + 64;
+            positions.reset(new std::uint32_t[capacity]);  // not initialised on purpose
+        }
+
+        count = 0;
+        prev_escaped = prev_in_string = prev_scalar = 0;
+
+        std::size_t i = 0;
+
+        for (; i + 64 <= s.size(); i += 64) step(s.data() + i, static_cast<std::uint32_t>(i));
+
+        if (i < s.size())  // tail padded with whitespace
+        {
+            char last[64];
+
+            std::memset(last, ' ', sizeof(last));
+            std::memcpy(last, s.data() + i, s.size() - i);
+
+            step(last, static_cast<std::uint32_t>(i));
+        }
+
+        return prev_in_string == 0;
+    }
+
+    std::size_t size() const noexcept { return count; }
+
+    std::uint32_t operator[] (std::size_t k) const noexcept { return positions[k]; }
+
+ private:
+    std::unique_ptr<std::uint32_t[]> positions;
+    std::size_t capacity = 0;
+    std::size_t count = 0;
+
+    std::uint64_t prev_escaped = 0;
+    std::uint64_t prev_in_string = 0;
+    std::uint64_t prev_scalar = 0;
+};
+
+
+// Stage 2: walk the structural positions once, and emit events into a Builder.
+// Checks nesting and punctuation, and that every token ends where the next
+// structural position starts (up to whitespace); scalars are not validated.
+// Strings are not read: the closing quote is the position after the opening one.
+template<class Builder>
+bool parse_indexed(std::string_view s, const structural_index& at, Builder& builder)
+{
+    enum class expect { value, value_or_close, key, key_or_close, colon, next };
+
+    char stack[1024];  // closing characters of the open containers
+    std::size_t depth = 0;
+    expect state = expect::value;
+
+    const auto is_value = [&state] { return (state == expect::value) || (state == expect::value_or_close); };
+    const auto is_key = [&state] { return (state == expect::key) || (state == expect::key_or_close); };
+
+    const auto is_ws = [](char c) { return (c == ' ') || (c == '\n') || (c == '\t') || (c == '\r'); };
+
+    for (std::size_t k = 0; k < at.size(); ++k)
+    {
+        const std::uint32_t p = at[k];
+        const std::size_t next = (k + 1 < at.size()) ? at[k + 1] : s.size();
+        const char c = s[p];
+
+        switch (c)
+        {
+            case '{':
+            case '[':
+                if ( ! is_value() || (depth == sizeof(stack))) return false;
+
+                stack[depth++] = (c == '{') ? '}' : ']';
+                builder.on_open(s.substr(p, 1));
+                state = (c == '{') ? expect::key_or_close : expect::value_or_close;
+                break;
+
+            case '}':
+            case ']':
+            {
+                const bool empty = (state == ((c == '}') ? expect::key_or_close : expect::value_or_close));
+
+                if (( ! empty && (state != expect::next)) || (depth == 0) || (stack[depth - 1] != c)) return false;
+
+                --depth;
+                builder.on_close();
+                state = expect::next;
+                break;
+            }
+
+            case ',':
+                if ((state != expect::next) || (depth == 0)) return false;
+
+                state = (stack[depth - 1] == '}') ? expect::key : expect::value;
+                break;
+
+            case ':':
+                if (state != expect::colon) return false;
+
+                state = expect::value;
+                break;
+
+            case '"':
+            {
+                if ( ! is_value() && ! is_key()) return false;
+
+                const std::uint32_t e = at[++k];  // closing quote, build() guarantees there is one
+                const std::size_t follows = (k + 1 < at.size()) ? at[k + 1] : s.size();
+
+                for (std::size_t w = e + 1; w < follows; ++w) if ( ! is_ws(s[w])) return false;  // e.g. ["a"x]
+
+                builder.on_scalar(s.substr(p + 1, e - p - 1));
+                state = is_key() ? expect::colon : expect::next;
+                break;
+            }
+
+            default:  // number, true, false, null: up to the next structural or whitespace
+            {
+                if ( ! is_value()) return false;
+
+                std::size_t e = p;
+
+                while ((e < next) && ! is_ws(s[e])) ++e;
+
+                for (std::size_t w = e; w < next; ++w) if ( ! is_ws(s[w])) return false;
+
+                builder.on_scalar(s.substr(p, e - p));
+                state = expect::next;
+                break;
+            }
+        }
+    }
+
+    if ((depth != 0) || (state != expect::next)) return false;
+
+    builder.on_end();
+
+    return true;
+}
+
+
+template<class Builder>
+bool parse_simd(std::string_view s, structural_index& idx, Builder& b)
+{
+    return idx.build(s) && parse_indexed(s, idx, b);
+}
+
+
+
+// ---
+
+
+template<class Node>
+std::size_t total_length(const Node& n)
+{
+    std::size_t r = 0;
+    bool head = true;
+
+    std::for_each(std::cbegin(n), std::cend(n), [&r, &head](const auto& x)
+    {
+        if (head) { r += x.value().size(); head = false; }
+        else r += total_length(x);
+    });
+
+    return r;
+}
+
+std::string make_payload(std::size_t records)
+{
+    std::string s = "[";
+
+    for (std::size_t i = 0; i < records; ++i)
+    {
+        s += (i ? "," : "");
+        s += R"({"id":)" + std::to_string(i)
+           + R"(,"name":"user)" + std::to_string(i)
+           + R"(","active":true,"tags":["a","bb","ccc"],"geo":{"lat":52.2297,"lon":21.0122}})";
+    }
+
+    return s + "]";
+}
+
+template<class F>
+double ms(F f)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    f();
+
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+
+// Messages with long text fields: fewer nodes per byte.
+std::string make_text_payload(std::size_t records)
+{
+    const std::string text(200, 'x');
+
+    std::string s = "[";
+
+    for (std::size_t i = 0; i < records; ++i)
+    {
+        s += (i ? "," : "");
+        s += R"({"id":)" + std::to_string(i) + R"(,"message":")" + text + R"(","source":"sensor \"north\""})";
+    }
+
+    return s + "]";
+}
+
+void bench(const char* name, const std::string& payload)
+{
+    const double mb = payload.size() / 1e6;
+
+    std::size_t a = 0, b = 0;
+
+    std::cout << name << ", " << mb << " MB\n";
+
+    {
+        json_document doc;
+        bool ok = false;
+        double t = 0;
+
+        for (int r = 0; r < 3; ++r)  // warm: document memory reused
+        {
+            doc.clear();
+            t = ms([&] { ok = parse(payload, doc); });
+        }
+
+        a = total_length(doc.root());
+
+        std::cout << "  recursive descent " << t << " ms, " << (mb / t) << " GB/s" << (ok ? "" : " (parse error)") << '\n';
+    }
+
+    {
+        structural_index idx;
+        json_document doc;
+        bool ok = false;
+        double t1 = 0, t2 = 0;
+
+        for (int r = 0; r < 3; ++r)
+        {
+            doc.clear();
+            t1 = ms([&] { ok = idx.build(payload); });
+            doc.reserve(idx.size());
+            t2 = ms([&] { ok = ok && parse_indexed(payload, idx, doc); });
+        }
+
+        b = total_length(doc.root());
+
+        std::cout << "  stage 1           " << t1 << " ms, " << (mb / t1) << " GB/s\n";
+        std::cout << "  stage 1 + 2       " << (t1 + t2) << " ms, " << (mb / (t1 + t2)) << " GB/s" << (ok ? "" : " (parse error)") << '\n';
+    }
+
+    std::cout << "  same content: " << std::boolalpha << (a == b) << '\n';
+}
+
+
+int main()
+{
+    bench("records", make_payload(200'000));
+    bench("text", make_text_payload(100'000));
+
+    const std::pair<std::string_view, bool> cases[] =
+    {
+        {R"({"a":1,})", false}, {R"([1 2])", false}, {R"({"a":"\"})", false}, {R"([}])", false}, {R"({"a" "b"})", false}
+      , {R"(["a""b"])", false}, {R"(["a"x])", false}, {R"("a"1)", false}, {R"({"a":"b"c})", false}, {R"([1"a"])", false}
+      , {R"({"a\\":[[], {}, "x\"y"]})", true}, {R"(["a" , "b" ,1 ])", true}
+    };
+
+    bool as_expected = true;
+
+    for (const auto& [text, valid] : cases)
+    {
+        structural_index idx;
+        json_document doc;
+
+        const bool accepted = parse_simd(text, idx, doc);
+
+        as_expected = as_expected && (accepted == valid);
+
+        std::cout << text << " -> " << (accepted ? "accepted" : "rejected") << '\n';
+    }
+
+    std::cout << "all as expected: " << as_expected << '\n';
+
+    return 0;
+}
+
+
+/*
+g++ -std=c++17 -O3 -mavx2 -mpclmul -Wall -pedantic -pthread main.cpp && ./a.out
+records, 21.3778 MB
+  recursive descent 63.0256 ms, 0.339192 GB/s
+  stage 1           11.8739 ms, 1.8004 GB/s
+  stage 1 + 2       59.323 ms, 0.360363 GB/s
+  same content: true
+text, 25.3889 MB
+  recursive descent 24.2706 ms, 1.04608 GB/s
+  stage 1           7.36161 ms, 3.44882 GB/s
+  stage 1 + 2       18.4485 ms, 1.3762 GB/s
+  same content: true
+{"a":1,} -> rejected
+[1 2] -> rejected
+{"a":"\"} -> rejected
+[}] -> rejected
+{"a" "b"} -> rejected
+["a""b"] -> rejected
+["a"x] -> rejected
+"a"1 -> rejected
+{"a":"b"c} -> rejected
+[1"a"] -> rejected
+{"a\\":[[], {}, "x\"y"]} -> accepted
+["a" , "b" ,1 ] -> accepted
+all as expected: true
+
+Without AVX2 (or PCLMUL) the portable classification is used instead:
+g++ -std=c++17 -O3 -Wall -pedantic -pthread main.cpp && ./a.out
+records, 21.3778 MB
+  recursive descent 65.2268 ms, 0.327745 GB/s
+  stage 1           102.857 ms, 0.20784 GB/s
+  stage 1 + 2       162.371 ms, 0.13166 GB/s
+  same content: true
+text, 25.3889 MB
+  recursive descent 24.9062 ms, 1.01938 GB/s
+  stage 1           101.25 ms, 0.250755 GB/s
+  stage 1 + 2       111.101 ms, 0.228521 GB/s
+  same content: true
+{"a":1,} -> rejected
+[1 2] -> rejected
+{"a":"\"} -> rejected
+[}] -> rejected
+{"a" "b"} -> rejected
+["a""b"] -> rejected
+["a"x] -> rejected
+"a"1 -> rejected
+{"a":"b"c} -> rejected
+[1"a"] -> rejected
+{"a\\":[[], {}, "x\"y"]} -> accepted
+["a" , "b" ,1 ] -> accepted
+all as expected: true
+*/